@@ -0,0 +1,575 @@
+// ==========================================================================
+//                             adapter_kernels.h
+// ==========================================================================
+// Copyright (c) 2006-2015, Knut Reinert, FU Berlin
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Knut Reinert or the FU Berlin nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL KNUT REINERT OR THE FU BERLIN BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// ==========================================================================
+// Author: Benjamin Menkuec <benjamin@menkuec.de>
+// ==========================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// SSE2 is part of every x86-64 cpu. The AVX2 kernel is compiled for its own target and only used
+// if the cpu supports it, so no special compiler flags are needed.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLEXCAT_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define FLEXCAT_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#endif
+
+#if defined(FLEXCAT_AVX2) && defined(__GNUC__)
+#define FLEXCAT_TARGET_AVX2 __attribute__((target("avx2")))
+#define FLEXCAT_TARGET_POPCNT __attribute__((target("popcnt")))
+#else
+#define FLEXCAT_TARGET_AVX2
+#define FLEXCAT_TARGET_POPCNT
+#endif
+
+// The kernels work on Dna5 ordinal values, with N being 4.
+constexpr unsigned char dna5CodeN = 4;
+
+// Scores one shift position of an adapter against a read: +1 for every equal base, -1 for every
+// mismatch, 0 if the read has an N. An N in the adapter only matches an N in the read.
+inline int scoreShiftScalar(const unsigned char* read, const unsigned char* adapter, const std::size_t len) noexcept
+{
+    int score = 0;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        if (adapter[i] == read[i])
+            ++score;
+        else if (read[i] != dna5CodeN)
+            --score;
+    }
+    return score;
+}
+
+// The vector kernels count matches and mismatches in byte lanes (a compare result of -1 is subtracted),
+// which are summed up before they can overflow.
+constexpr std::size_t maxLaneIterations = 255;
+
+#ifdef FLEXCAT_SSE2
+inline int horizontalSum(const __m128i counts) noexcept
+{
+    const __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+}
+
+inline int scoreShiftSse2(const unsigned char* read, const unsigned char* adapter, const std::size_t len) noexcept
+{
+    const __m128i n = _mm_set1_epi8(static_cast<char>(dna5CodeN));
+    int score = 0;
+    std::size_t i = 0;
+    while (i + 16 <= len)
+    {
+        __m128i matches = _mm_setzero_si128();
+        __m128i mismatches = _mm_setzero_si128();
+        for (std::size_t k = 0; k < maxLaneIterations && i + 16 <= len; ++k, i += 16)
+        {
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(read + i));
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(adapter + i));
+            const __m128i equal = _mm_cmpeq_epi8(r, a);
+            const __m128i countable = _mm_or_si128(equal, _mm_cmpeq_epi8(r, n));
+            matches = _mm_sub_epi8(matches, equal);
+            mismatches = _mm_sub_epi8(mismatches, _mm_andnot_si128(countable, _mm_set1_epi8(-1)));
+        }
+        score += horizontalSum(matches) - horizontalSum(mismatches);
+    }
+    return score + scoreShiftScalar(read + i, adapter + i, len - i);
+}
+#endif
+
+#ifdef FLEXCAT_AVX2
+FLEXCAT_TARGET_AVX2 inline int scoreShiftAvx2(const unsigned char* read, const unsigned char* adapter, const std::size_t len) noexcept
+{
+    const __m256i n = _mm256_set1_epi8(static_cast<char>(dna5CodeN));
+    int score = 0;
+    std::size_t i = 0;
+    while (i + 32 <= len)
+    {
+        __m256i matches = _mm256_setzero_si256();
+        __m256i mismatches = _mm256_setzero_si256();
+        for (std::size_t k = 0; k < maxLaneIterations && i + 32 <= len; ++k, i += 32)
+        {
+            const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(read + i));
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(adapter + i));
+            const __m256i equal = _mm256_cmpeq_epi8(r, a);
+            const __m256i countable = _mm256_or_si256(equal, _mm256_cmpeq_epi8(r, n));
+            matches = _mm256_sub_epi8(matches, equal);
+            mismatches = _mm256_sub_epi8(mismatches, _mm256_andnot_si256(countable, _mm256_set1_epi8(-1)));
+        }
+        const __m256i sums = _mm256_sub_epi64(_mm256_sad_epu8(matches, _mm256_setzero_si256()), _mm256_sad_epu8(mismatches, _mm256_setzero_si256()));
+        const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        score += _mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8));    // the sums are small, the low halves are enough
+    }
+    return score + scoreShiftSse2(read + i, adapter + i, len - i);
+}
+
+inline bool cpuHasAvx2() noexcept
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+using TScoreShiftKernel = int(*)(const unsigned char*, const unsigned char*, const std::size_t);
+
+inline TScoreShiftKernel selectScoreShiftKernel() noexcept
+{
+#ifdef FLEXCAT_AVX2
+    if (cpuHasAvx2())
+        return scoreShiftAvx2;
+#endif
+#ifdef FLEXCAT_SSE2
+    return scoreShiftSse2;
+#else
+    return scoreShiftScalar;
+#endif
+}
+
+// Same as scoreShiftScalar, using the widest vector instructions of the cpu.
+inline int scoreShift(const unsigned char* read, const unsigned char* adapter, const std::size_t len) noexcept
+{
+    static const TScoreShiftKernel kernel = selectScoreShiftKernel();
+    return kernel(read, adapter, len);
+}
+
+// Like scoreShift, in blocks of 64 bases, see scoreShiftPackedBounded.
+inline bool scoreShiftBounded(const unsigned char* read, const unsigned char* adapter, const std::size_t len, const int maxMismatches,
+    int& score) noexcept
+{
+    score = 0;
+    for (std::size_t i = 0; i < len; i += 64)
+    {
+        const std::size_t block = std::min<std::size_t>(64, len - i);
+        score += scoreShift(read + i, adapter + i, block);
+        if ((static_cast<int>(i + block) - score) / 2 > maxMismatches)
+            return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// 2-bit packed sequences
+// ============================================================================
+
+// A sequence with 64 bases per word: the two bits of each base are stored in two bit planes,
+// N is stored in a separate mask (with both plane bits 0). There is always a zero word behind
+// the last base, so a window of 64 bases can be taken at any position.
+struct PackedSequence
+{
+    std::vector<std::uint64_t> low, high, n;
+
+    void resize(const std::size_t len)
+    {
+        const auto words = len / 64 + 2;
+        low.assign(words, 0);
+        high.assign(words, 0);
+        n.assign(words, 0);
+    }
+
+    inline void set(const std::size_t pos, const unsigned char code) noexcept
+    {
+        const auto bit = std::uint64_t(1) << (pos % 64);
+        if (code == dna5CodeN)
+            n[pos / 64] |= bit;
+        else
+        {
+            low[pos / 64] |= (code & 1) ? bit : 0;
+            high[pos / 64] |= (code & 2) ? bit : 0;
+        }
+    }
+};
+
+FLEXCAT_TARGET_POPCNT inline int popcount64(const std::uint64_t x) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(x));
+#elif defined(_MSC_VER) && defined(FLEXCAT_SSE2)
+    return static_cast<int>(__popcnt(static_cast<unsigned int>(x)) + __popcnt(static_cast<unsigned int>(x >> 32)));
+#elif defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    return static_cast<int>(std::bitset<64>(x).count());
+#endif
+}
+
+inline std::uint64_t bitsAt(const std::vector<std::uint64_t>& words, const std::size_t pos) noexcept
+{
+    const auto word = pos / 64;
+    const auto shift = pos % 64;
+    return shift == 0 ? words[word] : (words[word] >> shift) | (words[word + 1] << (64 - shift));
+}
+
+// Scores len bases of read from readPos against adapter from adapterPos, like scoreShiftScalar.
+// Only called if the cpu has a popcount instruction, otherwise the byte kernels are faster.
+FLEXCAT_TARGET_POPCNT inline int scoreShiftPacked(const PackedSequence& read, const std::size_t readPos,
+    const PackedSequence& adapter, const std::size_t adapterPos, const std::size_t len) noexcept
+{
+    int score = 0;
+    for (std::size_t i = 0; i < len; i += 64)
+    {
+        const auto valid = len - i >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << (len - i)) - 1;
+        const auto readN = bitsAt(read.n, readPos + i);
+        const auto adapterN = bitsAt(adapter.n, adapterPos + i);
+        const auto different = (bitsAt(read.low, readPos + i) ^ bitsAt(adapter.low, adapterPos + i)) |
+            (bitsAt(read.high, readPos + i) ^ bitsAt(adapter.high, adapterPos + i));
+        const auto equal = (~(different | readN | adapterN) | (readN & adapterN)) & valid;
+        const auto mismatch = (different | adapterN) & ~readN & valid;
+        score += popcount64(equal) - popcount64(mismatch);
+    }
+    return score;
+}
+
+// Scores the overlap of two reads like the AdapterScoringMatrix: +1 for every equal base, -1 for
+// every mismatch, 0 if either base is N.
+inline int scoreOverlapScalar(const unsigned char* seq1, const unsigned char* seq2, const std::size_t len) noexcept
+{
+    int score = 0;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        if (seq1[i] == dna5CodeN || seq2[i] == dna5CodeN)
+            continue;
+        score += seq1[i] == seq2[i] ? 1 : -1;
+    }
+    return score;
+}
+
+FLEXCAT_TARGET_POPCNT inline int scoreOverlapPacked(const PackedSequence& seq1, const std::size_t pos1,
+    const PackedSequence& seq2, const std::size_t pos2, const std::size_t len) noexcept
+{
+    int score = 0;
+    for (std::size_t i = 0; i < len; i += 64)
+    {
+        const auto valid = len - i >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << (len - i)) - 1;
+        const auto scored = ~(bitsAt(seq1.n, pos1 + i) | bitsAt(seq2.n, pos2 + i)) & valid;
+        const auto different = (bitsAt(seq1.low, pos1 + i) ^ bitsAt(seq2.low, pos2 + i)) |
+            (bitsAt(seq1.high, pos1 + i) ^ bitsAt(seq2.high, pos2 + i));
+        score += popcount64(~different & scored) - popcount64(different & scored);
+    }
+    return score;
+}
+
+// Like scoreShiftPacked, but gives up as soon as (scored bases - score) / 2, which is a lower bound
+// of the mismatches of the whole shift, exceeds maxMismatches. Returns false then.
+FLEXCAT_TARGET_POPCNT inline bool scoreShiftPackedBounded(const PackedSequence& read, const std::size_t readPos,
+    const PackedSequence& adapter, const std::size_t adapterPos, const std::size_t len, const int maxMismatches, int& score) noexcept
+{
+    score = 0;
+    for (std::size_t i = 0; i < len; i += 64)
+    {
+        const std::size_t block = std::min<std::size_t>(64, len - i);
+        score += scoreShiftPacked(read, readPos + i, adapter, adapterPos + i, block);
+        if ((static_cast<int>(i + block) - score) / 2 > maxMismatches)
+            return false;
+    }
+    return true;
+}
+
+inline bool cpuHasPopcount() noexcept
+{
+#if defined(_MSC_VER) && defined(FLEXCAT_SSE2)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 23)) != 0;
+#elif defined(FLEXCAT_SSE2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt");
+#else
+    return true;    // the compiler picks the popcount of the target
+#endif
+}
+
+// The packed scoring is used if the cpu can count bits in one instruction.
+inline bool usePackedScoring() noexcept
+{
+    static const bool packed = cpuHasPopcount();
+    return packed;
+}
+
+// ============================================================================
+// Reads in lanes
+// ============================================================================
+
+// Up to readLanes reads in structure-of-arrays layout, so that one vector holds the same position
+// of all reads: base pos of lane l is codes[pos * readLanes + l]. The positions behind the end of
+// a read and unused lanes hold dna5CodePad, which scores 0.
+constexpr std::size_t readLanes = 32;
+constexpr unsigned char dna5CodePad = 5;
+
+struct ReadLanes
+{
+    std::size_t length;     // length of the longest read
+    std::vector<unsigned char> codes;
+
+    ReadLanes() : length(0) {};
+
+    void reset(const std::size_t len)
+    {
+        length = len;
+        codes.assign(len * readLanes, dna5CodePad);
+    }
+
+    inline void set(const std::size_t lane, const unsigned char* read, const std::size_t len) noexcept
+    {
+        for (std::size_t i = 0; i < len; ++i)
+            codes[i * readLanes + lane] = read[i];
+    }
+};
+
+// Scores len rows of lanes against one adapter base per row, like scoreShiftScalar for each lane.
+inline void scoreShiftLanesScalar(const unsigned char* rows, const unsigned char* adapter, const std::size_t len, int* scores) noexcept
+{
+    for (std::size_t lane = 0; lane < readLanes; ++lane)
+        scores[lane] = 0;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        const unsigned char* row = rows + i * readLanes;
+        for (std::size_t lane = 0; lane < readLanes; ++lane)
+        {
+            if (row[lane] == adapter[i])
+                ++scores[lane];
+            else if (row[lane] != dna5CodeN && row[lane] != dna5CodePad)
+                --scores[lane];
+        }
+    }
+}
+
+// The vector kernels add the scores of up to maxByteIterations rows in signed byte lanes, which are
+// then widened to 16 bit.
+constexpr std::size_t maxByteIterations = 127;
+
+#ifdef FLEXCAT_SSE2
+inline void scoreShiftLanesSse2(const unsigned char* rows, const unsigned char* adapter, const std::size_t len, int* scores) noexcept
+{
+    const __m128i n = _mm_set1_epi8(static_cast<char>(dna5CodeN));
+    const __m128i pad = _mm_set1_epi8(static_cast<char>(dna5CodePad));
+    const __m128i ones = _mm_set1_epi8(-1);
+    __m128i wide[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+    std::size_t i = 0;
+    while (i < len)
+    {
+        __m128i sums[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+        for (std::size_t k = 0; k < maxByteIterations && i < len; ++k, ++i)
+        {
+            const __m128i a = _mm_set1_epi8(static_cast<char>(adapter[i]));
+            for (std::size_t half = 0; half < 2; ++half)
+            {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i * readLanes + half * 16));
+                const __m128i equal = _mm_cmpeq_epi8(r, a);
+                const __m128i countable = _mm_or_si128(_mm_or_si128(equal, _mm_cmpeq_epi8(r, n)), _mm_cmpeq_epi8(r, pad));
+                sums[half] = _mm_add_epi8(_mm_sub_epi8(sums[half], equal), _mm_andnot_si128(countable, ones));
+            }
+        }
+        for (std::size_t half = 0; half < 2; ++half)
+        {
+            wide[half * 2] = _mm_add_epi16(wide[half * 2], _mm_srai_epi16(_mm_unpacklo_epi8(sums[half], sums[half]), 8));
+            wide[half * 2 + 1] = _mm_add_epi16(wide[half * 2 + 1], _mm_srai_epi16(_mm_unpackhi_epi8(sums[half], sums[half]), 8));
+        }
+    }
+    std::int16_t values[readLanes];
+    for (std::size_t k = 0; k < 4; ++k)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + k * 8), wide[k]);
+    for (std::size_t lane = 0; lane < readLanes; ++lane)
+        scores[lane] = values[lane];
+}
+#endif
+
+#ifdef FLEXCAT_AVX2
+FLEXCAT_TARGET_AVX2 inline void scoreShiftLanesAvx2(const unsigned char* rows, const unsigned char* adapter, const std::size_t len, int* scores) noexcept
+{
+    const __m256i n = _mm256_set1_epi8(static_cast<char>(dna5CodeN));
+    const __m256i pad = _mm256_set1_epi8(static_cast<char>(dna5CodePad));
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i wideLow = _mm256_setzero_si256();
+    __m256i wideHigh = _mm256_setzero_si256();
+    std::size_t i = 0;
+    while (i < len)
+    {
+        __m256i sums = _mm256_setzero_si256();
+        for (std::size_t k = 0; k < maxByteIterations && i < len; ++k, ++i)
+        {
+            const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i * readLanes));
+            const __m256i equal = _mm256_cmpeq_epi8(r, _mm256_set1_epi8(static_cast<char>(adapter[i])));
+            const __m256i countable = _mm256_or_si256(_mm256_or_si256(equal, _mm256_cmpeq_epi8(r, n)), _mm256_cmpeq_epi8(r, pad));
+            sums = _mm256_add_epi8(_mm256_sub_epi8(sums, equal), _mm256_andnot_si256(countable, ones));
+        }
+        wideLow = _mm256_add_epi16(wideLow, _mm256_cvtepi8_epi16(_mm256_castsi256_si128(sums)));
+        wideHigh = _mm256_add_epi16(wideHigh, _mm256_cvtepi8_epi16(_mm256_extracti128_si256(sums, 1)));
+    }
+    std::int16_t values[readLanes];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), wideLow);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + 16), wideHigh);
+    for (std::size_t lane = 0; lane < readLanes; ++lane)
+        scores[lane] = values[lane];
+}
+#endif
+
+using TScoreShiftLanesKernel = void(*)(const unsigned char*, const unsigned char*, const std::size_t, int*);
+
+inline TScoreShiftLanesKernel selectScoreShiftLanesKernel() noexcept
+{
+#ifdef FLEXCAT_AVX2
+    if (cpuHasAvx2())
+        return scoreShiftLanesAvx2;
+#endif
+#ifdef FLEXCAT_SSE2
+    return scoreShiftLanesSse2;
+#else
+    return scoreShiftLanesScalar;
+#endif
+}
+
+// Scores all lanes against the adapter placed at shiftPos. Only the rows of the reads are scored,
+// adapter bases in front of or behind the rows are not counted.
+inline void scoreShiftLanes(const ReadLanes& reads, const int shiftPos, const unsigned char* adapter, const std::size_t adapterLength,
+    int* scores) noexcept
+{
+    static const TScoreShiftLanesKernel kernel = selectScoreShiftLanesKernel();
+    const std::ptrdiff_t begin = shiftPos < 0 ? -static_cast<std::ptrdiff_t>(shiftPos) : 0;
+    const std::ptrdiff_t end = std::min<std::ptrdiff_t>(adapterLength, static_cast<std::ptrdiff_t>(reads.length) - shiftPos);
+    if (end > begin)
+        kernel(reads.codes.data() + (shiftPos + begin) * readLanes, adapter + begin, end - begin, scores);
+    else
+        kernel(reads.codes.data(), adapter, 0, scores);
+}
+
+// ============================================================================
+// Bit-parallel edit distance
+// ============================================================================
+
+// Pattern for the bit-parallel edit distance of Myers, in blocks of 64 bases as described by
+// Hyyrö: bit i of peq[code * blocks + b] is set if base 64 * b + i of the pattern matches code.
+// N matches every base.
+struct EditPattern
+{
+    std::size_t length;
+    std::size_t blocks;
+    std::vector<std::uint64_t> peq;
+
+    EditPattern() : length(0), blocks(0) {};
+};
+
+inline void buildEditPattern(const unsigned char* pattern, const std::size_t len, EditPattern& editPattern)
+{
+    editPattern.length = len;
+    editPattern.blocks = (len + 63) / 64;
+    editPattern.peq.assign((dna5CodeN + 1) * editPattern.blocks, 0);
+    for (std::size_t i = 0; i < len; ++i)
+        for (unsigned char code = 0; code <= dna5CodeN; ++code)
+            if (pattern[i] == code || pattern[i] == dna5CodeN || code == dna5CodeN)
+                editPattern.peq[code * editPattern.blocks + i / 64] |= std::uint64_t(1) << (i % 64);
+}
+
+// Computes one block of a text column from the vertical deltas (pv: +1, mv: -1) of the previous
+// column and the horizontal delta entering the block at the top, returns the delta leaving it at
+// the row of the high bit.
+inline int _advanceEditBlock(std::uint64_t& pv, std::uint64_t& mv, std::uint64_t eq, const int hin, const std::uint64_t high) noexcept
+{
+    const std::uint64_t xv = eq | mv;
+    if (hin < 0)
+        eq |= 1;
+    const std::uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    std::uint64_t ph = mv | ~(xh | pv);
+    std::uint64_t mh = pv & xh;
+    const int hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+    ph <<= 1;
+    mh <<= 1;
+    if (hin < 0)
+        mh |= 1;
+    else if (hin > 0)
+        ph |= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return hout;
+}
+
+// Edit distances of the pattern against a text, in which the alignment may start anywhere. The
+// first freeRows bases of the pattern may hang over the start of the text without cost.
+// lastRow[j] is the distance of the whole pattern ending in front of text position j,
+// lastColumn[i] the distance of the pattern prefix of length i ending at the end of the text.
+inline void editDistanceScan(const EditPattern& pattern, const unsigned char* text, const std::size_t len, const std::size_t freeRows,
+    std::vector<int>& lastRow, std::vector<int>& lastColumn)
+{
+    static thread_local std::vector<std::uint64_t> pv, mv;
+    static thread_local std::vector<int> blockScore;
+    const std::size_t blocks = pattern.blocks;
+    lastRow.assign(len + 1, 0);
+    lastColumn.assign(pattern.length + 1, 0);
+    if (blocks == 0)
+        return;
+    pv.resize(blocks);
+    mv.assign(blocks, 0);
+    blockScore.resize(blocks);
+    for (std::size_t b = 0; b < blocks; ++b)
+    {
+        // the first column is max(0, row - freeRows)
+        const std::size_t first = 64 * b;
+        const std::size_t free = freeRows > first ? std::min<std::size_t>(64, freeRows - first) : 0;
+        pv[b] = free == 64 ? 0 : ~std::uint64_t(0) << free;
+        const std::size_t last = std::min(pattern.length, first + 64);
+        blockScore[b] = last > freeRows ? static_cast<int>(last - freeRows) : 0;
+    }
+    const std::uint64_t lastHigh = std::uint64_t(1) << ((pattern.length - 1) % 64);
+    lastRow[0] = blockScore[blocks - 1];
+    for (std::size_t j = 0; j < len; ++j)
+    {
+        const std::uint64_t* eq = pattern.peq.data() + text[j] * blocks;
+        int h = 0;  // row 0 is 0 in every column, the alignment may start anywhere
+        for (std::size_t b = 0; b < blocks; ++b)
+        {
+            h = _advanceEditBlock(pv[b], mv[b], eq[b], h, b + 1 == blocks ? lastHigh : std::uint64_t(1) << 63);
+            blockScore[b] += h;
+        }
+        lastRow[j + 1] = blockScore[blocks - 1];
+    }
+    for (std::size_t i = 0; i < pattern.length; ++i)
+        lastColumn[i + 1] = lastColumn[i] + static_cast<int>((pv[i / 64] >> (i % 64)) & 1) - static_cast<int>((mv[i / 64] >> (i % 64)) & 1);
+}
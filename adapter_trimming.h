@@ -35,7 +35,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+
 #include <seqan/align.h>
+#include "adapter_kernels.h"
 #include "helper_functions.h"
 #include "general_stats.h"
 
@@ -86,9 +92,32 @@ namespace seqan{
 using TAdapterAlphabet = seqan::Dna5Q;
 using TAdapterSequence = seqan::String<TAdapterAlphabet>;
 
+// q-gram index of an adapter, built once when the adapters are loaded. It is used to skip the
+// alignment of reads which can not contain the adapter.
+constexpr unsigned int adapterIndexQ = 3;
+
+struct AdapterIndex
+{
+    std::vector<unsigned char> codes;       // Dna5 codes of the adapter
+    PackedSequence packed;
+    std::vector<unsigned int> qgramBegin;   // the positions of q-gram h are qgramPos[qgramBegin[h]] to qgramPos[qgramBegin[h + 1] - 1]
+    std::vector<unsigned int> qgramPos;
+
+    // the codes are empty if the adapter has not been indexed
+    inline bool built() const noexcept
+    {
+        return !codes.empty();
+    }
+
+    // adapters without q-gram index (containing N or not indexed at all) are always aligned
+    inline bool valid() const noexcept
+    {
+        return !qgramBegin.empty();
+    }
+};
+
 struct AdapterItem;
 typedef std::vector< AdapterItem > AdapterSet;
-using TReverseComplement = STRING_REVERSE_COMPLEMENT<TAdapterAlphabet>::Type;
 
 struct AdapterItem
 {
@@ -105,16 +134,19 @@ struct AdapterItem
     bool anchored;
     bool reverse;
     TAdapterSequence seq;
+    AdapterIndex index;
 
     AdapterItem() : adapterEnd(end3), overhang(0), id(0), anchored(false), reverse(false){};
     AdapterItem(const TAdapterSequence &adapter) : adapterEnd(end3), overhang(0), id(0), anchored(false), reverse(false), seq(adapter){};
     AdapterItem(const TAdapterSequence &adapter, const AdapterEnd adapterEnd, const unsigned overhang, const unsigned id, const bool anchored, const bool reverse)
         : adapterEnd(adapterEnd), overhang(overhang), id(id), anchored(anchored), reverse(reverse), seq(adapter) {};
 
-    AdapterItem getReverseComplement() const noexcept
+    // the sequence is copied once and complemented in place, the index is not copied as it belongs to the other strand
+    AdapterItem getReverseComplement() const
     {
-        auto seqCopy = seq;
-        return AdapterItem(TReverseComplement(seqCopy), adapterEnd, overhang, id, anchored, reverse);
+        AdapterItem adapterItem(seq, adapterEnd, overhang, id, anchored, reverse);
+        seqan::reverseComplement(adapterItem.seq);
+        return adapterItem;
     }
 
 
@@ -131,23 +163,85 @@ typedef seqan::Score<int, seqan::ScoreMatrix<seqan::Dna5, seqan::AdapterScoringM
 
 struct AdapterMatchSettings
 {
-    AdapterMatchSettings(const int m, const int e, const double er, const unsigned int oh, const unsigned int times) : min_length(m), errors(e), overhang(oh), errorRate(er), times(times)
+    AdapterMatchSettings(const int m, const int e, const double er, const unsigned int oh, const unsigned int times) : min_length(m), errors(e), overhang(oh), errorRate(er), times(times), gapped(false)
     {}
-    AdapterMatchSettings() : min_length(0), errors(0), overhang(0), errorRate(0), times(1) {};
+    AdapterMatchSettings() : min_length(0), errors(0), overhang(0), errorRate(0), times(1), gapped(false) {};
    
     unsigned int min_length; //The minimum length of the overlap.
 	int errors;     //The maximum number of errors we allow.
     unsigned int overhang;
 	double errorRate;  //The maximum number of errors allowed per overlap
     unsigned int times;
+    bool gapped;    //Allow indels, the errors are edits then (AlignAlgorithm::Myers).
 };
 
+// Scans a read for a group of adapters with the same end, direction and overhang in one pass.
+// Each adapter is a bit lane, a q-gram which several adapters have at the same position (like
+// the common part of an adapter panel) is stored and counted only once. The hits are counted
+// in bit-sliced counters, one counter word per shift and 64 adapters.
+// The shift of an adapter is given by its anchor: the read position of the adapter start for
+// 3' adapters and of the adapter end for 5' adapters, so it is the same for all lengths.
+struct AdapterScanner
+{
+    struct Entry
+    {
+        int anchorOffset;       // anchor = read position of the q-gram + anchorOffset
+        unsigned int word;
+        std::uint64_t lanes;
+    };
+    // short overlaps at the read ends are scored directly, once for all adapters with the same prefix or suffix
+    struct EndClass
+    {
+        std::vector<unsigned char> codes;   // the prefix or suffix
+        bool prefix;
+        unsigned int word;
+        std::uint64_t lanes;
+    };
+
+    AdapterItem::AdapterEnd adapterEnd;
+    bool reverse;
+    unsigned int overhang;
+    unsigned int maxLength;
+    unsigned int counterBits;
+    std::vector<unsigned int> adapters;         // lane -> adapter number
+    std::vector<unsigned int> lengths;          // the adapters of lengths[i] are lengthLanes[i * words + word]
+    std::vector<std::uint64_t> lengthLanes;
+    std::vector<unsigned int> qgramBegin;
+    std::vector<Entry> entries;
+    std::vector<EndClass> endClasses;
+
+    AdapterScanner() : adapterEnd(AdapterItem::end3), reverse(false), overhang(0), maxLength(0), counterBits(0) {};
+
+    inline unsigned int words() const noexcept
+    {
+        return static_cast<unsigned int>((adapters.size() + 63) / 64);
+    }
+};
+
+struct AdapterScanners
+{
+    AdapterMatchSettings mode;                  // the scanners are only valid for these settings
+    std::vector<int> hitsNeeded;                // per overlap: q-gram hits a match needs, 0 if it is scored directly, -1 if it can not match
+    std::vector<AdapterScanner> scanners;
+    std::vector<int> scannerOf;                 // adapter number -> scanner, -1 if the adapter is aligned on its own
+};
+
+// The adapters which apply to the reads of one direction and are long enough for the minimum
+// overlap, with their index and scanners. Built once after loading, the per read loops only go
+// through the adapters which can match.
+struct AdapterTable
+{
+    AdapterSet adapters;
+    AdapterScanners scanners;
+};
 
 struct AdapterTrimmingParams
 {
     bool pairedNoAdapterFile;
     bool run;
-    AdapterSet adapters;
+    AdapterSet adapters;            // all adapters, in the order of the adapter file
+    AdapterTable forwardAdapters;
+    AdapterTable reverseAdapters;
     AdapterMatchSettings mode;
     bool tag;
     AdapterTrimmingParams() : pairedNoAdapterFile(false), run(false), tag(false) {};
@@ -194,6 +288,7 @@ namespace AlignAlgorithm
 {
     struct NeedlemanWunsch {};
     struct Menkuec {};
+    struct Myers {};    // gapped, bit-parallel edit distance
 }
 
 template <typename TSeq, typename TAdapter>
@@ -220,12 +315,171 @@ void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const
     ret.first = globalAlignment(ret.second, adapterScore, config, shiftStartPos, shiftEndPos, seqan::LinearGaps());
 }
 
+// Bases are compared as Dna5, like the == of the quality alphabets does.
+template <typename TSeq>
+void _toDna5Codes(const TSeq& seq, std::vector<unsigned char>& codes)
+{
+    const auto len = length(seq);
+    codes.resize(len);
+    for (unsigned int i = 0; i < len; ++i)
+        codes[i] = static_cast<unsigned char>(seqan::ordValue(seqan::Dna5(seq[i])));
+}
+
+inline void _toPackedSequence(const std::vector<unsigned char>& codes, PackedSequence& packed)
+{
+    packed.resize(codes.size());
+    for (std::size_t i = 0; i < codes.size(); ++i)
+        packed.set(i, codes[i]);
+}
+
+// Hash of the q-gram starting at each position, -1 if the q-gram contains an N.
+inline void _qgramHashes(const std::vector<unsigned char>& codes, std::vector<int>& hashes)
+{
+    hashes.clear();
+    if (codes.size() < adapterIndexQ)
+        return;
+    hashes.resize(codes.size() - adapterIndexQ + 1);
+    const unsigned int mask = (1u << (2 * adapterIndexQ)) - 1;
+    unsigned int hash = 0;
+    std::size_t firstWithoutN = 0;
+    for (std::size_t i = 0; i < codes.size(); ++i)
+    {
+        if (codes[i] == dna5CodeN)
+            firstWithoutN = i + 1;
+        hash = ((hash << 2) | (codes[i] & 3)) & mask;
+        if (i + 1 >= adapterIndexQ)
+        {
+            const auto start = i + 1 - adapterIndexQ;
+            hashes[start] = start >= firstWithoutN ? static_cast<int>(hash) : -1;
+        }
+    }
+}
+
+inline void buildAdapterIndex(AdapterItem& adapterItem)
+{
+    auto& index = adapterItem.index;
+    _toDna5Codes(adapterItem.seq, index.codes);
+    _toPackedSequence(index.codes, index.packed);
+    index.qgramBegin.clear();
+    index.qgramPos.clear();
+    if (adapterItem.anchored || index.codes.size() < adapterIndexQ ||
+        std::find(index.codes.begin(), index.codes.end(), dna5CodeN) != index.codes.end())
+        return;
+    std::vector<int> hashes;
+    _qgramHashes(index.codes, hashes);
+    index.qgramBegin.assign((1u << (2 * adapterIndexQ)) + 1, 0);
+    for (const auto hash : hashes)
+        ++index.qgramBegin[hash + 1];
+    for (std::size_t h = 1; h < index.qgramBegin.size(); ++h)
+        index.qgramBegin[h] += index.qgramBegin[h - 1];
+    index.qgramPos.resize(hashes.size());
+    auto next = index.qgramBegin;
+    for (unsigned int pos = 0; pos < hashes.size(); ++pos)
+        index.qgramPos[next[hashes[pos]]++] = pos;
+}
+
+inline void buildAdapterIndex(AdapterSet& adapters)
+{
+    for (auto& adapterItem : adapters)
+        buildAdapterIndex(adapterItem);
+}
+
+// Result of the shift search of one adapter, without building an alignment.
+struct AdapterMatch
+{
+    int shiftPos;           // position of the adapter start relative to the read start
+    int score;
+    unsigned int overlap;
+    unsigned int adapter;   // index of the adapter in the adapter set
+
+    AdapterMatch() : shiftPos(0), score(std::numeric_limits<int>::min()), overlap(0), adapter(0) {};
+};
+
+// Mismatches ((overlap - score) / 2) a shift may have and still matter for the result: it has to
+// reach the best error rate so far and, with an error rate, it has to pass isMatch. The margin on
+// the error rate makes sure that a shift, which is abandoned although its float error rate would
+// have been the best one, would not have passed isMatch either.
+inline int _mismatchLimit(const unsigned int overlap, const float bestErrorRate, const AdapterMatchSettings& spec) noexcept
+{
+    int limit = overlap;
+    if (bestErrorRate < 1)
+    {
+        limit = static_cast<int>(bestErrorRate * overlap);
+        while (limit >= 0 && static_cast<float>(limit) / static_cast<float>(overlap) > bestErrorRate)
+            --limit;
+        while (limit < static_cast<int>(overlap) && static_cast<float>(limit + 1) / static_cast<float>(overlap) <= bestErrorRate)
+            ++limit;
+    }
+    if (spec.errorRate > 0)
+        limit = std::min(limit, static_cast<int>(spec.errorRate * (1 + 1e-6) * overlap));
+    return limit;
+}
+
+// Overlap of seq2 shifted to shiftPos of seq1, not positive if they do not overlap.
+inline int _shiftOverlap(const int shiftPos, const int lenSeq1, const int lenSeq2) noexcept
+{
+    return std::min(shiftPos + lenSeq2, lenSeq1) - std::max(shiftPos, 0);
+}
+
+// Takes the shift as the new best one if it has a lower error rate than the best one so far, or the same
+// error rate and a larger overlap. Both _bestShift and the lanes of _stripAdapterLanes decide with it.
+inline void _updateBestShift(AdapterMatch& best, float& bestErrorRate, const int shiftPos, const int score, const unsigned int overlap) noexcept
+{
+    const float errorRate = static_cast<float>((static_cast<int>(overlap) - score) / 2) / static_cast<float>(overlap);
+    if (errorRate < bestErrorRate || (errorRate == bestErrorRate && overlap > best.overlap))
+    {
+        best.shiftPos = shiftPos;
+        best.score = score;
+        best.overlap = overlap;
+        bestErrorRate = errorRate;
+    }
+}
+
 /*
 - shifts adapterTemplate against sequence
-- calculate score for each shift position
+- calculate score for each shift position (2-bit packed or vectorized, see adapter_kernels.h)
   - +1 for same base, -1 for mismatch, +0 for N
-- return score of the shift position, where the errorRate was minimal
+- return the shift position, where the errorRate was minimal
+- the packed sequences are only used if packed is set, the codes otherwise
+- if spec is given, only the result of isMatch for the returned shift has to be the same: shifts
+  are abandoned as soon as they can not become the best one or can not pass isMatch any more
 */
+inline AdapterMatch _bestShift(const std::vector<unsigned char>& codes1, const PackedSequence& packed1,
+    const std::vector<unsigned char>& codes2, const PackedSequence& packed2, const unsigned int lenSeq1, const unsigned int lenSeq2,
+    const int shiftStartPos, const int shiftEndPos, const bool packed, const AdapterMatchSettings* spec = nullptr) noexcept
+{
+    AdapterMatch best;
+    float bestErrorRate = std::numeric_limits<float>::max();
+    for (int shiftPos = shiftStartPos; shiftPos <= shiftEndPos; ++shiftPos)
+    {
+        const int signedOverlap = _shiftOverlap(shiftPos, lenSeq1, lenSeq2);
+        if (signedOverlap <= 0)
+            continue;
+        const unsigned int overlap = signedOverlap;
+        const unsigned int overlapStart = std::max(shiftPos, 0);
+        const unsigned int adapterStart = std::max(0, -shiftPos);
+        // a shift can at most tie with a perfect match, so it needs a longer overlap
+        if (spec != nullptr && bestErrorRate == 0 && overlap <= best.overlap)
+            continue;
+        int score;
+        // the bounded scoring checks after every 64 bases, shorter overlaps are scored in one go anyway
+        if (spec == nullptr || overlap <= 64)
+        {
+            score = packed ? scoreShiftPacked(packed1, overlapStart, packed2, adapterStart, overlap) :
+                scoreShift(codes1.data() + overlapStart, codes2.data() + adapterStart, overlap);
+        }
+        else
+        {
+            const int maxMismatches = _mismatchLimit(overlap, bestErrorRate, *spec);
+            if (packed ? !scoreShiftPackedBounded(packed1, overlapStart, packed2, adapterStart, overlap, maxMismatches, score) :
+                !scoreShiftBounded(codes1.data() + overlapStart, codes2.data() + adapterStart, overlap, maxMismatches, score))
+                continue;
+        }
+        _updateBestShift(best, bestErrorRate, shiftPos, score, overlap);
+    }
+    return best;
+}
+
 template <typename TSeq, typename TAdapter>
 void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const TAdapter& seq2, 
         const int leftOverhang, const int rightOverhang, const AlignAlgorithm::Menkuec&) noexcept
@@ -236,43 +490,27 @@ void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const
 
     const int shiftStartPos = -leftOverhang;
     const int shiftEndPos = length(seq1) - length(seq2) + rightOverhang;
-    const auto lenSeq1 = length(seq1);
-    const auto lenSeq2 = length(seq2);
-    int shiftPos = shiftStartPos;
-    int bestShiftPos = shiftStartPos;
-    int bestScore = std::numeric_limits<int>::min();
-    float bestErrorRate = std::numeric_limits<float>::max();
-    unsigned int bestOverlap = 0;
+    const int lenSeq1 = length(seq1);
+    const int lenSeq2 = length(seq2);
 
     if (shiftEndPos < shiftStartPos)
     {
-        ret.first = bestScore; // invalid constraints
+        ret.first = std::numeric_limits<int>::min(); // invalid constraints
         return;
     }
-    while (shiftPos <= shiftEndPos)
+    // the buffers keep their capacity between the calls
+    static thread_local std::vector<unsigned char> codes1, codes2;
+    static thread_local PackedSequence packed1, packed2;
+    const bool packed = usePackedScoring();
+    _toDna5Codes(seq1, codes1);
+    _toDna5Codes(seq2, codes2);
+    if (packed)
     {
-        const unsigned int overlapNegativeShift = std::min(shiftPos + lenSeq2, lenSeq1);
-        const unsigned int overlapPositiveShift = std::min(lenSeq1 - shiftPos, lenSeq2);
-        const unsigned int overlap = std::min(overlapNegativeShift, overlapPositiveShift);
-        const unsigned int overlapStart = std::max(shiftPos, 0);
-        int score = 0;
-        for (unsigned int pos = 0; pos < overlap; ++pos)
-        {
-            if (seq2[pos + std::min(0,shiftPos)*(-1)] == seq1[overlapStart + pos])
-                ++score;
-            else if (seq1[overlapStart + pos] != 'N')
-                --score;
-        }
-        const float errorRate = static_cast<float>((overlap-score)/2) / static_cast<float>(overlap);
-        if (errorRate < bestErrorRate || (errorRate == bestErrorRate && overlap > bestOverlap))
-        {
-            bestShiftPos = shiftPos;
-            bestScore = score;
-            bestErrorRate = errorRate;
-            bestOverlap = overlap;
-        }
-        ++shiftPos;
+        _toPackedSequence(codes1, packed1);
+        _toPackedSequence(codes2, packed2);
     }
+    const AdapterMatch best = _bestShift(codes1, packed1, codes2, packed2, lenSeq1, lenSeq2, shiftStartPos, shiftEndPos, packed);
+    const int bestShiftPos = best.overlap == 0 ? shiftStartPos : best.shiftPos;
     if (bestShiftPos < 0)
     {
         seqan::insertGaps(row(ret.second, 0), 0, - bestShiftPos); // top left
@@ -285,10 +523,10 @@ void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const
         seqan::insertGaps(row(ret.second, 1), 0, bestShiftPos); // bottom left
         seqan::insertGaps(row(ret.second, 1), lenSeq2+bestShiftPos, std::max<int>(0,lenSeq1 - lenSeq2 - bestShiftPos)); // bottom right
     }
-    ret.first = bestScore;
+    ret.first = best.score;
 }
 
-// used only for testing and paired end data
+// used only for testing
 template <typename TSeq, typename TAdapter>
 void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const TAdapter& seq2, const AlignAlgorithm::NeedlemanWunsch&) noexcept
 {
@@ -304,21 +542,52 @@ void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const
     ret.first = globalAlignment(ret.second, adapterScore, config, seqan::NeedlemanWunsch());
 }
 
+inline void _reverseComplementCodes(std::vector<unsigned char>& codes) noexcept
+{
+    std::reverse(codes.begin(), codes.end());
+    for (auto& code : codes)
+        if (code != dna5CodeN)
+            code = 3 - code;
+}
+
 template <typename TSeq>
 unsigned stripPair(TSeq& seq1, TSeq& seq2) noexcept
 {
     // When aligning the two sequences, the complementary sequence is reversed and
     // complemented, so we have an overlap alignment with complementary bases being the same.
-    using TAlphabet = typename seqan::Value<TSeq>::Type;
-    using TReverseComplement = typename STRING_REVERSE_COMPLEMENT<TAlphabet>::Type;
-    TReverseComplement mod(seq2);
-    typedef seqan::Align<TSeq> TAlign;
-    std::pair<int, TAlign> ret;
-    alignPair(ret, seq1, mod, AlignAlgorithm::NeedlemanWunsch());
-    const auto& score = ret.first;
-    const TAlign& align = ret.second;
-    // Use the overlap of the two sequences to determine the end position.
-    const unsigned overlap = getOverlap(align);
+    // The gap penalty of the overlap alignment was so high, that only the ungapped overlaps
+    // are scored here: the reverse complement of seq2 starts at shiftPos in seq1.
+    static thread_local std::vector<unsigned char> codes1, codes2;
+    static thread_local PackedSequence packed1, packed2;
+    _toDna5Codes(seq1, codes1);
+    _toDna5Codes(seq2, codes2);
+    _reverseComplementCodes(codes2);
+    const bool packed = usePackedScoring();
+    if (packed)
+    {
+        _toPackedSequence(codes1, packed1);
+        _toPackedSequence(codes2, packed2);
+    }
+    const int len1 = codes1.size();
+    const int len2 = codes2.size();
+    int score = 0;
+    int bestShiftPos = 0;
+    unsigned overlap = 0;
+    for (int shiftPos = 1 - len2; shiftPos < len1; ++shiftPos)
+    {
+        const unsigned shiftOverlap = std::min(len1, shiftPos + len2) - std::max(shiftPos, 0);
+        const unsigned start1 = std::max(shiftPos, 0);
+        const unsigned start2 = std::max(-shiftPos, 0);
+        const int shiftScore = packed ? scoreOverlapPacked(packed1, start1, packed2, start2, shiftOverlap) :
+            scoreOverlapScalar(codes1.data() + start1, codes2.data() + start2, shiftOverlap);
+        // the longer overlap wins if the scores are the same
+        if (overlap == 0 || shiftScore > score || (shiftScore == score && shiftOverlap > overlap))
+        {
+            score = shiftScore;
+            bestShiftPos = shiftPos;
+            overlap = shiftOverlap;
+        }
+    }
     const unsigned mismatches = (overlap - score) / 2;
     // We require a certain correct overlap to exclude spurious hits.
     // (Especially reverse 3'->5' alignments not caused by adapters.)
@@ -326,8 +595,9 @@ unsigned stripPair(TSeq& seq1, TSeq& seq2) noexcept
     {
         return 0;
     }
-    // Get actual size of the insert (possible to determine from overlap etc.).
-    const unsigned insert = getInsertSize(align);
+    // Get actual size of the insert: both sequences minus the overlap and the overhangs
+    // (seq2 in front of seq1, seq1 behind seq2).
+    const unsigned insert = len1 + len2 - overlap - std::max(-bestShiftPos, 0) - std::max(0, len1 - bestShiftPos - len2);
     // Now cut both sequences to insert size (no cuts happen if they are smaller)
     if (length(seq1) > insert)
     {
@@ -369,106 +639,685 @@ struct StripAdapterDirection
     static const bool value = _direction;
 };
 
-template <typename TSeq, typename TAdapters, typename TStripAdapterDirection>
-unsigned stripAdapter(TSeq& seq, AdapterTrimmingStats& stats, TAdapters const& adapters, AdapterMatchSettings const& spec,
-    const TStripAdapterDirection&)
+// Largest number of mismatches isMatch accepts for an overlap, -1 if there is none.
+inline int _maxMismatches(const unsigned int overlap, const AdapterMatchSettings& spec) noexcept
 {
-    using TAlign = seqan::Align<TSeq>;
-    AlignAlgorithm::Menkuec alignAlgorithm;
+    if (spec.errorRate <= 0)
+        return spec.errors;
+    int mismatches = static_cast<int>(spec.errorRate * overlap);
+    while (mismatches > 0 && static_cast<double>(mismatches) / static_cast<double>(overlap) > spec.errorRate)
+        --mismatches;
+    while (static_cast<double>(mismatches + 1) / static_cast<double>(overlap) <= spec.errorRate)
+        ++mismatches;
+    return mismatches;
+}
 
-    unsigned removed{ 0 };
-    std::vector<std::tuple<unsigned int, unsigned int, TAlign, AdapterItem>> matches;
-    matches.reserve(spec.times);
-    for (unsigned int n = 0;n < spec.times; ++n)
+// Gapped alignment of the adapter prefix of length prefix, which ends in front of read position end
+// with maxEdits edits (see editDistanceScan). The adapter is aligned backwards from the end, up to
+// leftOverhang adapter bases may hang over the read start. Of the alignments with the lowest error
+// rate (edits / aligned adapter bases) the one with the most aligned adapter bases and then the
+// leftmost read start is taken. Returns the edits, ops gets the alignment from left to right if given:
+// 'M' for a base pair, 'I' for a read base against a gap, 'D' for an adapter base against a gap.
+inline int _gappedAlignment(const std::vector<unsigned char>& read, const std::vector<unsigned char>& adapter, const unsigned int prefix,
+    const unsigned int end, const unsigned int leftOverhang, const int maxEdits, unsigned int& start, unsigned int& hang,
+    std::vector<char>* ops = nullptr)
+{
+    static thread_local std::vector<int> edits;
+    // an alignment with maxEdits edits can not span more read bases
+    const unsigned int cols = std::min<unsigned int>(end, prefix + maxEdits) + 1;
+    edits.resize((prefix + 1) * cols);
+    const auto cost = [&](const unsigned int a, const unsigned int r)
     {
-        matches.clear();
+        const unsigned char x = adapter[prefix - a];
+        const unsigned char y = read[end - r];
+        return x == y || x == dna5CodeN || y == dna5CodeN ? 0 : 1;
+    };
+    // row a, column r: the last a bases of the prefix against the last r read bases in front of end
+    for (unsigned int r = 0; r < cols; ++r)
+        edits[r] = r;
+    for (unsigned int a = 1; a <= prefix; ++a)
+    {
+        int* row = edits.data() + a * cols;
+        const int* above = row - cols;
+        row[0] = a;
+        for (unsigned int r = 1; r < cols; ++r)
+            row[r] = std::min(above[r - 1] + cost(a, r), std::min(above[r], row[r - 1]) + 1);
+    }
+    int best = std::numeric_limits<int>::max();
+    unsigned int bestA = 0, bestR = 0;
+    for (unsigned int r = cols; r-- > 0;)
+    {
+        // at least one adapter base stays aligned
+        const unsigned int maxHang = r == end ? std::min(leftOverhang, prefix - 1) : 0;
+        for (unsigned int h = 0; h <= maxHang; ++h)
         {
-            std::pair<int, TAlign> ret;
-            for (auto const& adapterItem : adapters)
+            const unsigned int a = prefix - h;
+            const int current = edits[a * cols + r];
+            const long long lower = static_cast<long long>(current) * bestA;
+            const long long higher = static_cast<long long>(best) * a;
+            if (bestA == 0 || lower < higher || (lower == higher && a > bestA))
             {
-                //std::cout << "seq: " << seq << std::endl;
-                //std::cout << "adapter: " << adapterItem.seq << std::endl;
-                if (static_cast<unsigned>(length(adapterItem.seq)) < spec.min_length)
-                    continue;
-                if (TStripAdapterDirection::value == adapterDirection::reverse && adapterItem.reverse == false)
-                    continue;
-                if (TStripAdapterDirection::value == adapterDirection::forward && adapterItem.reverse == true)
-                    continue;
+                best = current;
+                bestA = a;
+                bestR = r;
+            }
+        }
+    }
+    start = end - bestR;
+    hang = prefix - bestA;
+    if (ops != nullptr)
+    {
+        ops->clear();
+        unsigned int a = bestA, r = bestR;
+        while (a > 0 || r > 0)
+        {
+            const int current = edits[a * cols + r];
+            if (a > 0 && r > 0 && current == edits[(a - 1) * cols + r - 1] + cost(a, r))
+            {
+                ops->push_back('M');
+                --a;
+                --r;
+            }
+            else if (a > 0 && current == edits[(a - 1) * cols + r] + 1)
+            {
+                ops->push_back('D');
+                --a;
+            }
+            else
+            {
+                ops->push_back('I');
+                --r;
+            }
+        }
+    }
+    return best;
+}
 
-                const auto& adapterSequence = adapterItem.seq;
-                const unsigned int oppositeEndOverhang = adapterItem.anchored == true ? length(adapterSequence) - length(seq) : adapterItem.overhang;
-                const unsigned int sameEndOverhang = adapterItem.anchored == true ? 0 : length(adapterItem.seq) - spec.min_length;
-                if (adapterItem.adapterEnd == AdapterItem::end3)
-                    alignPair(ret, seq, adapterSequence, oppositeEndOverhang, sameEndOverhang, alignAlgorithm);
-                else
-                    alignPair(ret, seq, adapterSequence, sameEndOverhang, oppositeEndOverhang, alignAlgorithm);
+/*
+- gapped match of a 3' adapter (AlignAlgorithm::Myers): the whole adapter ending anywhere in the read,
+  or a prefix of at least lenAdapter - rightOverhang bases ending at the read end
+- edit distances of all of them from one bit-parallel scan of the read, see editDistanceScan
+- like in _bestShift the lowest error rate (edits / aligned adapter bases) wins, ties go to the larger
+  overlap. Adapter bases hanging over the read start are free in the scan, so candidates which may hang
+  are aligned first to know their overlap.
+- the edits count as mismatches: score = overlap - 2 * edits, the shift position is the read
+  position of the adapter start
+- if spec is given, the start of the alignment is only searched if the best match can pass isMatch
+*/
+inline AdapterMatch _bestGappedMatch(const std::vector<unsigned char>& read, const std::vector<unsigned char>& adapter,
+    const unsigned int leftOverhang, const unsigned int rightOverhang, const AdapterMatchSettings* spec = nullptr, std::vector<char>* ops = nullptr)
+{
+    static thread_local EditPattern pattern;
+    static thread_local std::vector<int> lastRow, lastColumn;
+    static thread_local std::vector<std::tuple<unsigned int, unsigned int, int, unsigned int>> hanging;  // prefix, end, scan edits, order
+    const unsigned int lenRead = read.size();
+    const unsigned int lenAdapter = adapter.size();
+    if (lenRead == 0 || lenAdapter == 0)
+        return AdapterMatch();
+    buildEditPattern(adapter.data(), lenAdapter, pattern);
+    editDistanceScan(pattern, read.data(), lenRead, leftOverhang, lastRow, lastColumn);
 
-                const int score = ret.first;
-                if (score < 0)
-                    continue;
-                const unsigned int overlap = getOverlap(ret.second);
-                const int mismatches = (overlap - score) / 2;
-                //std::cout << "score: " << ret.first << " er: " << (float)mismatches/overlap << " overlap: " << overlap << " mismatches: " << mismatches << std::endl;
-                //std::cout << ret.second << std::endl;
+    // ties of error rate and overlap go to the candidate which comes first in the order of the scan
+    unsigned int bestPrefix = 0, bestEnd = 0, bestOverlap = 0, bestOrder = 0;
+    int bestScanEdits = 0, bestEdits = 0;
+    float bestErrorRate = std::numeric_limits<float>::max();
+    const auto better = [&](const float errorRate, const unsigned int overlap, const unsigned int order)
+    {
+        return errorRate < bestErrorRate || (errorRate == bestErrorRate && (overlap > bestOverlap || (overlap == bestOverlap && order < bestOrder)));
+    };
+    const auto take = [&](const unsigned int prefix, const unsigned int end, const int scanEdits, const unsigned int order,
+        const unsigned int overlap, const int edits)
+    {
+        const float errorRate = static_cast<float>(edits) / static_cast<float>(overlap);
+        if (!better(errorRate, overlap, order))
+            return;
+        bestPrefix = prefix;
+        bestEnd = end;
+        bestOverlap = overlap;
+        bestOrder = order;
+        bestScanEdits = scanEdits;
+        bestEdits = edits;
+        bestErrorRate = errorRate;
+    };
+    // The alignment can only reach the read start if there are at most prefix + edits read bases in front
+    // of end. These candidates are aligned after the others, most of them can not win then.
+    hanging.clear();
+    const auto consider = [&](const unsigned int prefix, const unsigned int end, const int scanEdits, const unsigned int order)
+    {
+        if (leftOverhang != 0 && end <= prefix + scanEdits)
+            hanging.emplace_back(prefix, end, scanEdits, order);
+        else
+            take(prefix, end, scanEdits, order, prefix, scanEdits);
+    };
+    for (unsigned int end = 1; end <= lenRead; ++end)
+        consider(lenAdapter, end, lastRow[end], end);
+    const unsigned int minPrefix = rightOverhang < lenAdapter ? lenAdapter - rightOverhang : 1;
+    for (unsigned int prefix = minPrefix; prefix < lenAdapter; ++prefix)
+        consider(prefix, lenRead, lastColumn[prefix], lenRead + prefix);
+    for (const auto& candidate : hanging)
+    {
+        unsigned int prefix, end, order;
+        int scanEdits;
+        std::tie(prefix, end, scanEdits, order) = candidate;
+        // the overlap is at most prefix, so this is the lowest error rate the candidate can have
+        if (!better(static_cast<float>(scanEdits) / static_cast<float>(prefix), prefix, order))
+            continue;
+        unsigned int start, hang;
+        const int edits = _gappedAlignment(read, adapter, prefix, end, leftOverhang, scanEdits, start, hang);
+        take(prefix, end, scanEdits, order, prefix - hang, edits);
+    }
+
+    if (bestOverlap == 0 || (spec != nullptr && (static_cast<int>(bestOverlap) < 2 * bestEdits || !isMatch(bestOverlap, bestEdits, *spec))))
+        return AdapterMatch();
+    unsigned int start, hang;
+    const int edits = _gappedAlignment(read, adapter, bestPrefix, bestEnd, leftOverhang, bestScanEdits, start, hang, ops);
+    AdapterMatch best;
+    best.shiftPos = static_cast<int>(start) - static_cast<int>(hang);
+    best.overlap = bestPrefix - hang;
+    best.score = static_cast<int>(best.overlap) - 2 * edits;
+    return best;
+}
+
+// Gapped match of the adapter within the shift range, 5' adapters are matched as 3' adapters of the
+// reversed read. The shift position is the read position of the adapter start, like in _bestShift.
+inline AdapterMatch _gappedAdapterMatch(const std::vector<unsigned char>& readCodes, const std::vector<unsigned char>& reversedReadCodes,
+    const std::vector<unsigned char>& adapterCodes, const AdapterItem& adapterItem, const int shiftStartPos, const int shiftEndPos,
+    const AdapterMatchSettings& spec)
+{
+    static thread_local std::vector<unsigned char> reversedAdapter;
+    const int lenRead = readCodes.size();
+    const int lenAdapter = adapterCodes.size();
+    const unsigned int leftOverhang = std::max(0, -shiftStartPos);
+    const unsigned int rightOverhang = std::max(0, shiftEndPos - (lenRead - lenAdapter));
+    if (adapterItem.adapterEnd == AdapterItem::end3)
+        return _bestGappedMatch(readCodes, adapterCodes, leftOverhang, rightOverhang, &spec);
+    reversedAdapter.assign(adapterCodes.rbegin(), adapterCodes.rend());
+    AdapterMatch match = _bestGappedMatch(reversedReadCodes, reversedAdapter, rightOverhang, leftOverhang, &spec);
+    if (match.overlap != 0)
+        match.shiftPos = lenRead - match.shiftPos - lenAdapter;
+    return match;
+}
 
-                if (isMatch(overlap, mismatches, spec))
-                    matches.push_back(std::make_tuple(score, overlap, ret.second, std::ref(adapterItem)));
+// gapped, seq2 is aligned like a 3' adapter, see _bestGappedMatch
+template <typename TSeq, typename TAdapter>
+void alignPair(std::pair<int, seqan::Align<TSeq> >& ret, const TSeq& seq1, const TAdapter& seq2,
+        const int leftOverhang, const int rightOverhang, const AlignAlgorithm::Myers&) noexcept
+{
+    seqan::resize(rows(ret.second), 2);
+    seqan::assignSource(row(ret.second, 0), seq1);
+    seqan::assignSource(row(ret.second, 1), seq2);
+
+    static thread_local std::vector<unsigned char> codes1, codes2;
+    static thread_local std::vector<char> ops;
+    _toDna5Codes(seq1, codes1);
+    _toDna5Codes(seq2, codes2);
+    const AdapterMatch best = _bestGappedMatch(codes1, codes2, std::max(0, leftOverhang), std::max(0, rightOverhang), nullptr, &ops);
+    if (best.overlap == 0)
+    {
+        ret.first = std::numeric_limits<int>::min(); // no alignment within the overhangs
+        return;
+    }
+    const unsigned int hang = std::max(0, -best.shiftPos);
+    const unsigned int start = std::max(0, best.shiftPos);
+    seqan::insertGaps(row(ret.second, 0), 0, hang); // top left
+    seqan::insertGaps(row(ret.second, 1), 0, start); // bottom left
+    unsigned int pos = hang + start;
+    unsigned int end1 = start;
+    unsigned int end2 = hang;
+    for (const char op : ops)
+    {
+        if (op != 'D')
+            ++end1;
+        else
+            seqan::insertGap(row(ret.second, 0), pos);
+        if (op != 'I')
+            ++end2;
+        else
+            seqan::insertGap(row(ret.second, 1), pos);
+        ++pos;
+    }
+    seqan::insertGaps(row(ret.second, 1), pos, length(seq1) - end1); // bottom right
+    seqan::insertGaps(row(ret.second, 0), pos, length(seq2) - end2); // top right
+    ret.first = best.score;
+}
+
+// Q-gram hits a match with this overlap needs on its diagonal (see _mayContainAdapter), 0 if the
+// overlap is too short for the q-gram lemma and has to be scored directly, -1 if it can not match.
+inline int _hitsNeeded(const unsigned int overlap, const unsigned int readN, const AdapterMatchSettings& spec) noexcept
+{
+    if (overlap == 0 || overlap < spec.min_length)
+        return -1;
+    const int maxMismatches = _maxMismatches(overlap, spec);
+    if (maxMismatches < 0)
+        return -1;
+    const int q = static_cast<int>(adapterIndexQ);
+    return std::max(0, static_cast<int>(overlap) - q + 1 - q * (maxMismatches + static_cast<int>(readN)));
+}
+
+/*
+Returns false only if no shift position between shiftStartPos and shiftEndPos is a match, so
+the alignment of the adapter can be skipped without changing the result.
+- a match with overlap L has at most maxMismatches(L) mismatches and readN read N's, each destroying
+  at most q of the L - q + 1 q-grams on its diagonal, so it needs L - q + 1 - q * (maxMismatches + readN)
+  shared q-grams on that diagonal (q-gram lemma)
+- short overlaps at the read ends (partial adapters) need no shared q-gram, they are scored directly
+*/
+inline bool _mayContainAdapter(const std::vector<unsigned char>& read, const std::vector<int>& readHashes, const unsigned int readN,
+    const AdapterIndex& index, const int shiftStartPos, const int shiftEndPos, const AdapterMatchSettings& spec)
+{
+    if (shiftEndPos < shiftStartPos)
+        return false;
+    static thread_local std::vector<unsigned int> hits;
+    hits.assign(shiftEndPos - shiftStartPos + 1, 0);
+    for (unsigned int readPos = 0; readPos < readHashes.size(); ++readPos)
+    {
+        if (readHashes[readPos] < 0)
+            continue;
+        for (auto i = index.qgramBegin[readHashes[readPos]]; i < index.qgramBegin[readHashes[readPos] + 1]; ++i)
+        {
+            const int shiftPos = static_cast<int>(readPos) - static_cast<int>(index.qgramPos[i]);
+            if (shiftPos >= shiftStartPos && shiftPos <= shiftEndPos)
+                ++hits[shiftPos - shiftStartPos];
+        }
+    }
+    const int lenRead = static_cast<int>(read.size());
+    const int lenAdapter = static_cast<int>(index.codes.size());
+    for (int shiftPos = shiftStartPos; shiftPos <= shiftEndPos; ++shiftPos)
+    {
+        const int overlap = std::min(shiftPos + lenAdapter, lenRead) - std::max(shiftPos, 0);
+        if (overlap <= 0)
+            continue;
+        const int neededHits = _hitsNeeded(overlap, readN, spec);
+        if (neededHits < 0)
+            continue;
+        if (neededHits > 0)
+        {
+            if (hits[shiftPos - shiftStartPos] >= static_cast<unsigned int>(neededHits))
+                return true;
+            continue;
+        }
+        const int score = scoreShiftScalar(read.data() + std::max(shiftPos, 0), index.codes.data() + std::max(-shiftPos, 0), overlap);
+        if (score >= 0 && isMatch(overlap, (overlap - score) / 2, spec))
+            return true;
+    }
+    return false;
+}
+
+inline bool _sameMatchSettings(const AdapterMatchSettings& a, const AdapterMatchSettings& b) noexcept
+{
+    return a.min_length == b.min_length && a.errors == b.errors && a.errorRate == b.errorRate;
+}
+
+inline void _buildAdapterScanner(AdapterScanner& scanner, const AdapterSet& adapters, const std::vector<int>& hitsNeeded)
+{
+    const unsigned int words = scanner.words();
+    const bool end3 = scanner.adapterEnd == AdapterItem::end3;
+    for (const auto adapterNum : scanner.adapters)
+        scanner.maxLength = std::max<unsigned int>(scanner.maxLength, adapters[adapterNum].index.codes.size());
+    scanner.counterBits = 1;
+    while ((1u << scanner.counterBits) <= scanner.maxLength - adapterIndexQ + 1)
+        ++scanner.counterBits;
+
+    // q-grams at the same anchor offset are merged
+    std::map<std::tuple<int, int, unsigned int>, std::uint64_t> qgrams;
+    std::map<std::tuple<bool, std::vector<unsigned char>, unsigned int>, std::uint64_t> endClasses;
+    std::vector<int> hashes;
+    for (unsigned int lane = 0; lane < scanner.adapters.size(); ++lane)
+    {
+        const auto& codes = adapters[scanner.adapters[lane]].index.codes;
+        const unsigned int len = codes.size();
+        const unsigned int word = lane / 64;
+        const std::uint64_t bit = std::uint64_t(1) << (lane % 64);
+        const auto length = std::find(scanner.lengths.begin(), scanner.lengths.end(), len) - scanner.lengths.begin();
+        if (length == static_cast<std::ptrdiff_t>(scanner.lengths.size()))
+        {
+            scanner.lengths.push_back(len);
+            scanner.lengthLanes.resize(scanner.lengthLanes.size() + words, 0);
+        }
+        scanner.lengthLanes[length * words + word] |= bit;
+
+        _qgramHashes(codes, hashes);
+        for (unsigned int pos = 0; pos < hashes.size(); ++pos)
+            qgrams[std::make_tuple(hashes[pos], end3 ? -static_cast<int>(pos) : static_cast<int>(len - pos), word)] |= bit;
+
+        // the overlaps which are scored directly: the adapter start at the read end and the adapter end at the read start
+        for (unsigned int overlap = 1; overlap < len; ++overlap)
+        {
+            if (hitsNeeded[overlap] != 0)
+                continue;
+            const bool withOverhang = overlap + scanner.overhang >= len;
+            if (end3 || withOverhang)
+                endClasses[std::make_tuple(true, std::vector<unsigned char>(codes.begin(), codes.begin() + overlap), word)] |= bit;
+            if (!end3 || withOverhang)
+                endClasses[std::make_tuple(false, std::vector<unsigned char>(codes.end() - overlap, codes.end()), word)] |= bit;
+        }
+    }
+    scanner.qgramBegin.assign((1u << (2 * adapterIndexQ)) + 1, 0);
+    for (const auto& qgram : qgrams)
+    {
+        ++scanner.qgramBegin[std::get<0>(qgram.first) + 1];
+        scanner.entries.push_back(AdapterScanner::Entry{ std::get<1>(qgram.first), std::get<2>(qgram.first), qgram.second });
+    }
+    for (std::size_t h = 1; h < scanner.qgramBegin.size(); ++h)
+        scanner.qgramBegin[h] += scanner.qgramBegin[h - 1];
+    for (const auto& endClass : endClasses)
+        scanner.endClasses.push_back(AdapterScanner::EndClass{ std::get<1>(endClass.first), std::get<0>(endClass.first), std::get<2>(endClass.first), endClass.second });
+}
+
+// Groups the adapters which can be scanned together. Anchored adapters, adapters with N and
+// adapters which are too short for the q-gram lemma are aligned on their own.
+inline void buildAdapterScanners(AdapterScanners& scanners, const AdapterSet& adapters, const AdapterMatchSettings& spec)
+{
+    scanners.mode = spec;
+    scanners.scanners.clear();
+    scanners.scannerOf.assign(adapters.size(), -1);
+    unsigned int maxLength = 0;
+    for (const auto& adapterItem : adapters)
+        maxLength = std::max<unsigned int>(maxLength, adapterItem.index.codes.size());
+    scanners.hitsNeeded.resize(maxLength + 1);
+    for (unsigned int overlap = 0; overlap <= maxLength; ++overlap)
+        scanners.hitsNeeded[overlap] = _hitsNeeded(overlap, 0, spec);
+
+    for (unsigned int adapterNum = 0; adapterNum < adapters.size(); ++adapterNum)
+    {
+        const auto& adapterItem = adapters[adapterNum];
+        if (adapterItem.anchored || !adapterItem.index.valid() || scanners.hitsNeeded[adapterItem.index.codes.size()] <= 0)
+            continue;
+        auto scanner = std::find_if(scanners.scanners.begin(), scanners.scanners.end(), [&adapterItem](const AdapterScanner& s)
+        {
+            return s.adapterEnd == adapterItem.adapterEnd && s.reverse == adapterItem.reverse && s.overhang == adapterItem.overhang;
+        });
+        if (scanner == scanners.scanners.end())
+        {
+            scanners.scanners.emplace_back();
+            scanner = scanners.scanners.end() - 1;
+            scanner->adapterEnd = adapterItem.adapterEnd;
+            scanner->reverse = adapterItem.reverse;
+            scanner->overhang = adapterItem.overhang;
+        }
+        scanner->adapters.push_back(adapterNum);
+    }
+    // a single adapter is filtered faster on its own
+    scanners.scanners.erase(std::remove_if(scanners.scanners.begin(), scanners.scanners.end(),
+        [](const AdapterScanner& scanner) { return scanner.adapters.size() < 2; }), scanners.scanners.end());
+    for (unsigned int scannerNum = 0; scannerNum < scanners.scanners.size(); ++scannerNum)
+    {
+        auto& scanner = scanners.scanners[scannerNum];
+        for (const auto adapterNum : scanner.adapters)
+            scanners.scannerOf[adapterNum] = static_cast<int>(scannerNum);
+        _buildAdapterScanner(scanner, adapters, scanners.hitsNeeded);
+    }
+}
+
+// Fills the table with the adapters for the reads of the direction. The ids are kept, so the
+// statistics are counted for the adapters of the full set.
+inline void buildAdapterTable(AdapterTable& table, const AdapterSet& adapters, const bool reverse, const AdapterMatchSettings& spec)
+{
+    table.adapters.clear();
+    for (const auto& adapterItem : adapters)
+        if (adapterItem.reverse == reverse && static_cast<unsigned>(length(adapterItem.seq)) >= spec.min_length)
+            table.adapters.push_back(adapterItem);
+    buildAdapterIndex(table.adapters);
+    buildAdapterScanners(table.scanners, table.adapters, spec);
+}
+
+// Marks the adapters of the scanner which may match the read in candidates, with the same guarantee
+// as _mayContainAdapter. The read must not contain N and must not be shorter than the adapters.
+inline void _scanAdapters(const AdapterScanner& scanner, const std::vector<int>& hitsNeeded, const std::vector<unsigned char>& read,
+    const std::vector<int>& readHashes, const AdapterMatchSettings& spec, std::vector<unsigned char>& candidates)
+{
+    const int lenRead = static_cast<int>(read.size());
+    const unsigned int words = scanner.words();
+    const unsigned int bits = scanner.counterBits;
+    const bool end3 = scanner.adapterEnd == AdapterItem::end3;
+    const int anchorBegin = end3 ? -static_cast<int>(scanner.overhang) : static_cast<int>(spec.min_length);
+    const int anchorEnd = end3 ? lenRead - static_cast<int>(spec.min_length) : lenRead + static_cast<int>(scanner.overhang);
+    if (anchorEnd < anchorBegin)
+        return;
+    static thread_local std::vector<std::uint64_t> counters, found;
+    counters.assign((anchorEnd - anchorBegin + 1) * words * bits, 0);
+    found.assign(words, 0);
+
+    // one pass over the read for all adapters
+    for (unsigned int readPos = 0; readPos < readHashes.size(); ++readPos)
+    {
+        const int hash = readHashes[readPos];
+        if (hash < 0)
+            continue;
+        for (auto i = scanner.qgramBegin[hash]; i < scanner.qgramBegin[hash + 1]; ++i)
+        {
+            const auto& entry = scanner.entries[i];
+            const int anchor = static_cast<int>(readPos) + entry.anchorOffset;
+            if (anchor < anchorBegin || anchor > anchorEnd)
+                continue;
+            std::uint64_t* counter = &counters[((anchor - anchorBegin) * words + entry.word) * bits];
+            std::uint64_t carry = entry.lanes;
+            for (unsigned int bit = 0; carry != 0 && bit < bits; ++bit)
+            {
+                const std::uint64_t next = counter[bit] & carry;
+                counter[bit] ^= carry;
+                carry = next;
             }
         }
-        if (matches.empty())
-            return removed;
+    }
+    for (int anchor = anchorBegin; anchor <= anchorEnd; ++anchor)
+    {
+        for (unsigned int word = 0; word < words; ++word)
+        {
+            // the lowest number of hits an adapter of this word needs at this anchor
+            std::uint64_t lanes = 0;
+            int threshold = std::numeric_limits<int>::max();
+            for (unsigned int length = 0; length < scanner.lengths.size(); ++length)
+            {
+                const std::uint64_t lengthLanes = scanner.lengthLanes[length * words + word];
+                if (lengthLanes == 0)
+                    continue;
+                const int len = static_cast<int>(scanner.lengths[length]);
+                const int shiftPos = end3 ? anchor : anchor - len;
+                const int overlap = std::min(shiftPos + len, lenRead) - std::max(shiftPos, 0);
+                if (overlap <= 0 || hitsNeeded[overlap] <= 0)
+                    continue;
+                lanes |= lengthLanes;
+                threshold = std::min(threshold, hitsNeeded[overlap]);
+            }
+            if (lanes == 0)
+                continue;
+            // compare the bit-sliced counters with the threshold, from the highest bit down
+            const std::uint64_t* counter = &counters[((anchor - anchorBegin) * words + word) * bits];
+            std::uint64_t greater = 0;
+            std::uint64_t equal = ~std::uint64_t(0);
+            for (unsigned int bit = bits; bit-- > 0;)
+            {
+                const std::uint64_t thresholdBit = ((threshold >> bit) & 1) ? ~std::uint64_t(0) : 0;
+                greater |= equal & counter[bit] & ~thresholdBit;
+                equal &= ~(counter[bit] ^ thresholdBit);
+            }
+            found[word] |= (greater | equal) & lanes;
+        }
+    }
+    for (const auto& endClass : scanner.endClasses)
+    {
+        if ((found[endClass.word] & endClass.lanes) == endClass.lanes)
+            continue;
+        const int overlap = static_cast<int>(endClass.codes.size());
+        const int score = scoreShiftScalar(read.data() + (endClass.prefix ? lenRead - overlap : 0), endClass.codes.data(), overlap);
+        if (score >= 0 && isMatch(overlap, (overlap - score) / 2, spec))
+            found[endClass.word] |= endClass.lanes;
+    }
+    for (unsigned int word = 0; word < words; ++word)
+        for (unsigned int bit = 0; found[word] != 0 && bit < 64; ++bit)
+            if ((found[word] >> bit) & 1)
+                candidates[scanner.adapters[word * 64 + bit]] = 1;
+}
 
-        // select best matching adapter
-        auto maxIt = matches.cbegin();
-        for (auto it = matches.cbegin(); it != matches.cend();++it)
-            if (std::get<0>(*it)>std::get<0>(*maxIt))
-                maxIt = it;
+// Shift positions alignPair tries for an adapter.
+inline void _adapterShiftRange(const AdapterItem& adapterItem, const unsigned int lenSeq, const AdapterMatchSettings& spec,
+    int& shiftStartPos, int& shiftEndPos) noexcept
+{
+    const unsigned int lenAdapter = length(adapterItem.seq);
+    const unsigned int oppositeEndOverhang = adapterItem.anchored == true ? lenAdapter - lenSeq : adapterItem.overhang;
+    const unsigned int sameEndOverhang = adapterItem.anchored == true ? 0 : lenAdapter - spec.min_length;
+    const int leftOverhang = adapterItem.adapterEnd == AdapterItem::end3 ? oppositeEndOverhang : sameEndOverhang;
+    const int rightOverhang = adapterItem.adapterEnd == AdapterItem::end3 ? sameEndOverhang : oppositeEndOverhang;
+    shiftStartPos = -leftOverhang;
+    shiftEndPos = static_cast<int>(lenSeq) - static_cast<int>(lenAdapter) + rightOverhang;
+}
 
-        // erase best matching adapter from sequence
-        const auto score = std::get<0>(*maxIt);
-        const auto overlap = std::get<1>(*maxIt);
-        const TAlign align = std::get<2>(*maxIt);
-        AdapterItem adapterItem = std::get<3>(*maxIt);
-        const auto mismatches = (overlap - score) / 2;
-        unsigned eraseStart = 0;
-        unsigned eraseEnd = 0;
-        if (adapterItem.adapterEnd == AdapterItem::end3)
+// Marks the adapters which have to be aligned against the read in candidates.
+template <typename TAdapters>
+void _adapterCandidates(const std::vector<unsigned char>& readCodes, const std::vector<int>& readHashes, TAdapters const& adapters,
+    AdapterMatchSettings const& spec, AdapterScanners const* scanners, const bool reverse, std::vector<unsigned char>& candidates)
+{
+    static thread_local std::vector<unsigned char> scanned;
+    const unsigned int lenSeq = readCodes.size();
+    const unsigned int readN = static_cast<unsigned int>(std::count(readCodes.begin(), readCodes.end(), dna5CodeN));
+    candidates.assign(adapters.size(), 0);
+    // the scanners find the candidates of their adapters in one pass, reads with N are filtered per adapter
+    const bool scan = !spec.gapped && scanners != nullptr && readN == 0 && scanners->scannerOf.size() == adapters.size() &&
+        _sameMatchSettings(scanners->mode, spec);
+    if (scan)
+    {
+        scanned.assign(scanners->scanners.size(), 0);
+        for (unsigned int scannerNum = 0; scannerNum < scanners->scanners.size(); ++scannerNum)
         {
-            eraseStart = toViewPosition(row(align, 1), 0);
-            eraseEnd = length(seq);
-            //std::cout << "adapter start position: " << toViewPosition(row(ret.second, 1), 0) << std::endl;
+            const auto& scanner = scanners->scanners[scannerNum];
+            if (scanner.reverse != reverse || lenSeq < scanner.maxLength)
+                continue;
+            _scanAdapters(scanner, scanners->hitsNeeded, readCodes, readHashes, spec, candidates);
+            scanned[scannerNum] = 1;
         }
-        else
+    }
+    for (unsigned int adapterNum = 0; adapterNum < adapters.size(); ++adapterNum)
+    {
+        auto const& adapterItem = adapters[adapterNum];
+        if (static_cast<unsigned>(length(adapterItem.seq)) < spec.min_length || adapterItem.reverse != reverse)
         {
-            eraseStart = 0;
-            eraseEnd = std::min<unsigned>(length(seq),toViewPosition(row(align, 1), length(adapterItem.seq)) - toViewPosition(row(align, 0), 0));
-            //std::cout << "adapter end position: " << toViewPosition(row(ret.second, 1), length(adapterItem.seq)) - toViewPosition(row(ret.second, 0), 0) << std::endl;
+            candidates[adapterNum] = 0;
+            continue;
         }
+        const int scannerNum = scan ? scanners->scannerOf[adapterNum] : -1;
+        if (scannerNum >= 0 && scanned[scannerNum])
+            continue;   // set by the scanner
+        int shiftStartPos, shiftEndPos;
+        _adapterShiftRange(adapterItem, lenSeq, spec, shiftStartPos, shiftEndPos);
+        // the q-gram hits of a gapped match are not on one diagonal
+        candidates[adapterNum] = spec.gapped || adapterItem.anchored || !adapterItem.index.valid() ||
+            _mayContainAdapter(readCodes, readHashes, readN, adapterItem.index, shiftStartPos, shiftEndPos, spec);
+    }
+}
+
+// Erases the adapter of the match from the read, returns the number of removed bases.
+template <typename TSeq>
+unsigned _removeAdapter(TSeq& seq, AdapterTrimmingStats& stats, const AdapterItem& adapterItem, const AdapterMatch& match)
+{
+    const auto score = match.score;
+    const auto overlap = match.overlap;
+    const unsigned mismatches = (overlap - score) / 2;
+    unsigned eraseStart = 0;
+    unsigned eraseEnd = 0;
+    if (adapterItem.adapterEnd == AdapterItem::end3)
+    {
+        eraseStart = std::max(match.shiftPos, 0);
+        eraseEnd = length(seq);
+    }
+    else
+    {
+        eraseStart = 0;
+        eraseEnd = std::min<unsigned>(length(seq), match.shiftPos + length(adapterItem.seq));
+    }
+
+    seqan::erase(seq, eraseStart, eraseEnd);
 
-        //std::cout << "unstripped seq: " << seq << " erase: " << eraseStart << " " << eraseEnd;
-        seqan::erase(seq, eraseStart, eraseEnd);
-        removed += eraseEnd - eraseStart;
-        //std::cout << "\nstripped seq  : " << seq << std::endl;
+    // update statistics
 
-        // update statistics
+    const auto statisticLen = eraseEnd - eraseStart;
+    if (stats.removedLength.size() < statisticLen)
+        stats.removedLength.resize(statisticLen);
+    if (stats.removedLength[statisticLen - 1].size() < mismatches + 1)
+        stats.removedLength[statisticLen - 1].resize(mismatches + 1);
+    ++stats.removedLength[statisticLen - 1][mismatches];
 
-        const auto statisticLen = eraseEnd - eraseStart;
-        if (stats.removedLength.size() < statisticLen)
-            stats.removedLength.resize(statisticLen);
-        if (stats.removedLength[statisticLen - 1].size() < mismatches + 1)
-            stats.removedLength[statisticLen - 1].resize(mismatches + 1);
-        ++stats.removedLength[statisticLen - 1][mismatches];
+    if (stats.numRemoved.size() < adapterItem.id + 1)
+        throw(std::runtime_error("error: numRemoved too small!"));
+    ++stats.numRemoved[adapterItem.id];
 
-        if (stats.numRemoved.size() < adapterItem.id + 1)
+    stats.overlapSum += overlap;
+    stats.maxOverlap = std::max(stats.maxOverlap, overlap);
+    stats.minOverlap = std::min(stats.minOverlap, overlap);
+    return eraseEnd - eraseStart;
+}
+
+// The match with the highest score, the first one if several have the same score.
+inline const AdapterMatch& _bestAdapterMatch(const std::vector<AdapterMatch>& matches) noexcept
+{
+    auto maxIt = matches.cbegin();
+    for (auto it = matches.cbegin(); it != matches.cend();++it)
+        if (it->score > maxIt->score)
+            maxIt = it;
+    return *maxIt;
+}
+
+template <typename TSeq, typename TAdapters, typename TStripAdapterDirection>
+unsigned stripAdapter(TSeq& seq, AdapterTrimmingStats& stats, TAdapters const& adapters, AdapterMatchSettings const& spec,
+    const TStripAdapterDirection&, AdapterScanners const* scanners = nullptr)
+{
+    unsigned removed{ 0 };
+    // the buffers keep their capacity between the calls, so there is no allocation per read
+    static thread_local std::vector<AdapterMatch> matches;
+    static thread_local std::vector<unsigned char> readCodes, reversedReadCodes, adapterCodes, candidates;
+    static thread_local std::vector<int> readHashes;
+    static thread_local PackedSequence readPacked, adapterPacked;
+    const bool packed = usePackedScoring();
+    for (unsigned int n = 0;n < spec.times; ++n)
+    {
+        matches.clear();
+        // the read is converted once for all adapters
+        _toDna5Codes(seq, readCodes);
+        _qgramHashes(readCodes, readHashes);
+        if (packed)
+            _toPackedSequence(readCodes, readPacked);
+        if (spec.gapped)
+            reversedReadCodes.assign(readCodes.rbegin(), readCodes.rend());
+        _adapterCandidates(readCodes, readHashes, adapters, spec, scanners, TStripAdapterDirection::value == adapterDirection::reverse, candidates);
+        for (unsigned int adapterNum = 0; adapterNum < adapters.size(); ++adapterNum)
         {
-            std::cout << "error: numRemoved too small!" << std::endl;
-            throw(std::runtime_error("error: numRemoved too small!"));
+            if (!candidates[adapterNum])
+                continue;
+            auto const& adapterItem = adapters[adapterNum];
+            int shiftStartPos, shiftEndPos;
+            _adapterShiftRange(adapterItem, length(seq), spec, shiftStartPos, shiftEndPos);
+
+            // adapters which have not been indexed are converted here
+            const auto* codes = &adapterItem.index.codes;
+            const auto* packedAdapter = &adapterItem.index.packed;
+            if (!adapterItem.index.built())
+            {
+                _toDna5Codes(adapterItem.seq, adapterCodes);
+                if (packed)
+                    _toPackedSequence(adapterCodes, adapterPacked);
+                codes = &adapterCodes;
+                packedAdapter = &adapterPacked;
+            }
+            // anchored adapters are always matched without gaps
+            AdapterMatch match = spec.gapped && !adapterItem.anchored ?
+                _gappedAdapterMatch(readCodes, reversedReadCodes, *codes, adapterItem, shiftStartPos, shiftEndPos, spec) :
+                _bestShift(readCodes, readPacked, *codes, *packedAdapter, length(seq), length(adapterItem.seq),
+                    shiftStartPos, shiftEndPos, packed, &spec);
+            if (match.score < 0)
+                continue;
+            const int mismatches = (static_cast<int>(match.overlap) - match.score) / 2;
+            if (isMatch(match.overlap, mismatches, spec))
+            {
+                match.adapter = adapterNum;
+                matches.push_back(match);
+            }
         }
-        ++stats.numRemoved[adapterItem.id];
+        if (matches.empty())
+            return removed;
 
-        stats.overlapSum += overlap;
-        stats.maxOverlap = std::max(stats.maxOverlap, overlap);
-        stats.minOverlap = std::min(stats.minOverlap, overlap);
+        // erase best matching adapter from sequence
+        const AdapterMatch& best = _bestAdapterMatch(matches);
+        removed += _removeAdapter(seq, stats, adapters[best.adapter], best);
         // dont try more adapter trimming if the read is too short already
         if (static_cast<unsigned>(length(seq)) < spec.min_length)
             return removed;
@@ -476,45 +1325,213 @@ unsigned stripAdapter(TSeq& seq, AdapterTrimmingStats& stats, TAdapters const& a
     return removed;
 }
 
-template < template <typename> class TRead, typename TSeq, typename TAdaptersArray, typename TSpec, typename TTagAdapter,
-    typename = std::enable_if_t<std::is_same<TRead<TSeq>, Read<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplex<TSeq>>::value> >
-void stripAdapterBatch(std::vector<TRead<TSeq>>& reads, TAdaptersArray const& adapters, TSpec const& spec, const bool pairedNoAdapterFile,
-    AdapterTrimmingStats& stats, TTagAdapter, bool = false) noexcept(!TTagAdapter::value)
+/*
+Strips the adapters from a batch of reads. The first round is computed adapter by adapter: the reads
+which may contain the adapter are put into the lanes of ReadLanes and scored at each shift
+position together, so the vector units are full even for short adapters. The further rounds
+(spec.times > 1) are done read by read with stripAdapter.
+The result is the same as calling stripAdapter for each read.
+*/
+template <typename TSeq, typename TAdapters, typename TStripAdapterDirection>
+void _stripAdapterLanes(std::vector<TSeq*>& seqs, std::vector<unsigned>& removed, AdapterTrimmingStats& stats, TAdapters const& adapters,
+    AdapterScanners const* scanners, AdapterMatchSettings const& spec, const TStripAdapterDirection& direction)
 {
-    (void)pairedNoAdapterFile;
-    for(auto& read: reads)
+    static thread_local std::vector<std::vector<unsigned char>> readCodes;
+    static thread_local std::vector<std::vector<AdapterMatch>> readMatches;
+    static thread_local std::vector<std::vector<unsigned int>> adapterReads;
+    static thread_local std::vector<unsigned char> adapterCodes, candidates;
+    static thread_local std::vector<int> readHashes;
+    static thread_local ReadLanes lanes;
+    static thread_local PackedSequence unusedPacked;
+    const bool reverse = TStripAdapterDirection::value == adapterDirection::reverse;
+    removed.assign(seqs.size(), 0);
+    if (spec.times == 0)
+        return;
+    if (spec.gapped)
     {
-        if (seqan::empty(read.seq))
+        // the lanes only score shifts without gaps
+        for (unsigned int readNum = 0; readNum < seqs.size(); ++readNum)
+            removed[readNum] = stripAdapter(*seqs[readNum], stats, adapters, spec, direction, scanners);
+        return;
+    }
+    if (readCodes.size() < seqs.size())
+    {
+        readCodes.resize(seqs.size());
+        readMatches.resize(seqs.size());
+    }
+    adapterReads.resize(adapters.size());
+    for (auto& reads : adapterReads)
+        reads.clear();
+
+    // the reads each adapter has to be aligned with
+    for (unsigned int readNum = 0; readNum < seqs.size(); ++readNum)
+    {
+        readMatches[readNum].clear();
+        _toDna5Codes(*seqs[readNum], readCodes[readNum]);
+        _qgramHashes(readCodes[readNum], readHashes);
+        _adapterCandidates(readCodes[readNum], readHashes, adapters, spec, scanners, reverse, candidates);
+        for (unsigned int adapterNum = 0; adapterNum < adapters.size(); ++adapterNum)
+            if (candidates[adapterNum])
+                adapterReads[adapterNum].push_back(readNum);
+    }
+
+    // first round, the matches of each read are added in the order of the adapters like in stripAdapter
+    int scores[readLanes];
+    AdapterMatch best[readLanes];
+    float bestErrorRate[readLanes];
+    for (unsigned int adapterNum = 0; adapterNum < adapters.size(); ++adapterNum)
+    {
+        auto const& adapterItem = adapters[adapterNum];
+        const auto& reads = adapterReads[adapterNum];
+        const auto* codes = &adapterItem.index.codes;
+        if (!adapterItem.index.built())
+        {
+            _toDna5Codes(adapterItem.seq, adapterCodes);
+            codes = &adapterCodes;
+        }
+        const unsigned int lenAdapter = codes->size();
+        for (std::size_t first = 0; first < reads.size(); first += readLanes)
+        {
+            const std::size_t numLanes = std::min(readLanes, reads.size() - first);
+            if (adapterItem.anchored)
+            {
+                // the shift range of anchored adapters depends on the read length
+                for (std::size_t lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto& read = readCodes[reads[first + lane]];
+                    int shiftStartPos, shiftEndPos;
+                    _adapterShiftRange(adapterItem, read.size(), spec, shiftStartPos, shiftEndPos);
+                    best[lane] = _bestShift(read, unusedPacked, *codes, unusedPacked, read.size(), lenAdapter, shiftStartPos, shiftEndPos, false);
+                }
+            }
+            else
+            {
+                std::size_t maxLength = 0;
+                for (std::size_t lane = 0; lane < numLanes; ++lane)
+                    maxLength = std::max(maxLength, readCodes[reads[first + lane]].size());
+                lanes.reset(maxLength);
+                for (std::size_t lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto& read = readCodes[reads[first + lane]];
+                    lanes.set(lane, read.data(), read.size());
+                    best[lane] = AdapterMatch();
+                    bestErrorRate[lane] = std::numeric_limits<float>::max();
+                }
+                // the shift range of the longest read contains the ranges of all others
+                int shiftStartPos, shiftEndPos;
+                _adapterShiftRange(adapterItem, maxLength, spec, shiftStartPos, shiftEndPos);
+                for (int shiftPos = shiftStartPos; shiftPos <= shiftEndPos; ++shiftPos)
+                {
+                    scoreShiftLanes(lanes, shiftPos, codes->data(), lenAdapter, scores);
+                    for (std::size_t lane = 0; lane < numLanes; ++lane)
+                    {
+                        const int lenRead = readCodes[reads[first + lane]].size();
+                        if (shiftPos > lenRead - static_cast<int>(maxLength) + shiftEndPos)
+                            continue;
+                        const int signedOverlap = _shiftOverlap(shiftPos, lenRead, lenAdapter);
+                        if (signedOverlap > 0)
+                            _updateBestShift(best[lane], bestErrorRate[lane], shiftPos, scores[lane], signedOverlap);
+                    }
+                }
+            }
+            for (std::size_t lane = 0; lane < numLanes; ++lane)
+            {
+                if (best[lane].score < 0)
+                    continue;
+                const int mismatches = (static_cast<int>(best[lane].overlap) - best[lane].score) / 2;
+                if (isMatch(best[lane].overlap, mismatches, spec))
+                {
+                    best[lane].adapter = adapterNum;
+                    readMatches[reads[first + lane]].push_back(best[lane]);
+                }
+            }
+        }
+    }
+
+    AdapterMatchSettings furtherRounds = spec;
+    --furtherRounds.times;
+    for (unsigned int readNum = 0; readNum < seqs.size(); ++readNum)
+    {
+        const auto& matches = readMatches[readNum];
+        if (matches.empty())
             continue;
-        const unsigned over = stripAdapter(read.seq, stats, adapters, spec, StripAdapterDirection<adapterDirection::forward>());
-        if (TTagAdapter::value && over != 0)
-            insertAfterFirstToken(read.id, ":AdapterRemoved");
+        auto& seq = *seqs[readNum];
+        const AdapterMatch& bestMatch = _bestAdapterMatch(matches);
+        removed[readNum] = _removeAdapter(seq, stats, adapters[bestMatch.adapter], bestMatch);
+        if (static_cast<unsigned>(length(seq)) >= spec.min_length && furtherRounds.times > 0)
+            removed[readNum] += stripAdapter(seq, stats, adapters, furtherRounds, direction, scanners);
     }
+}
+
+// single-end reads are stripped with the forward adapters only
+template < template <typename> class TRead, typename TSeq, typename TSpec, typename TTagAdapter,
+    typename = std::enable_if_t<std::is_same<TRead<TSeq>, Read<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplex<TSeq>>::value> >
+void stripAdapterBatch(std::vector<TRead<TSeq>>& reads, AdapterTable const& forwardAdapters, AdapterTable const& reverseAdapters, TSpec const& spec,
+    const bool pairedNoAdapterFile, AdapterTrimmingStats& stats, TTagAdapter, bool = false) noexcept(!TTagAdapter::value)
+{
+    (void)reverseAdapters;
+    (void)pairedNoAdapterFile;
+    static thread_local std::vector<TSeq*> seqs;
+    static thread_local std::vector<unsigned> removed;
+    seqs.clear();
+    for (auto& read : reads)
+        if (!seqan::empty(read.seq))
+            seqs.push_back(&read.seq);
+    _stripAdapterLanes(seqs, removed, stats, forwardAdapters.adapters, &forwardAdapters.scanners, spec,
+        StripAdapterDirection<adapterDirection::forward>());
+    if (!TTagAdapter::value)
+        return;
+    // the reads may be empty now, so they are found by their address
+    unsigned int readNum = 0;
+    for (auto& read : reads)
+        if (readNum < seqs.size() && seqs[readNum] == &read.seq && removed[readNum++] != 0)
+            insertAfterFirstToken(read.id, ":AdapterRemoved");
     return;
 }
 
 // pairedEnd adapters will be trimmed in single mode, each seperately
-template < template <typename> class TRead, typename TSeq, typename TAdaptersArray, typename TSpec, typename TTagAdapter,
+template < template <typename> class TRead, typename TSeq, typename TSpec, typename TTagAdapter,
     typename = std::enable_if_t<std::is_same<TRead<TSeq>, ReadPairedEnd<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplexPairedEnd<TSeq>>::value> >
-    void stripAdapterBatch(std::vector<TRead<TSeq>>& reads, TAdaptersArray const& adapters, TSpec const& spec, const bool pairedNoAdapterFile,
-        AdapterTrimmingStats& stats, TTagAdapter) noexcept(!TTagAdapter::value)
+    void stripAdapterBatch(std::vector<TRead<TSeq>>& reads, AdapterTable const& forwardAdapters, AdapterTable const& reverseAdapters, TSpec const& spec,
+        const bool pairedNoAdapterFile, AdapterTrimmingStats& stats, TTagAdapter) noexcept(!TTagAdapter::value)
 {
+    if (pairedNoAdapterFile)
+    {
+        for (auto& read : reads)
+            if (!seqan::empty(read.seq))
+                stripPair(read.seq, read.seqRev);
+        return;
+    }
+    // the forward and reverse reads are stripped as two batches, the reverse read is only stripped
+    // if the forward read is not empty
+    static thread_local std::vector<TSeq*> seqs, seqsRev;
+    static thread_local std::vector<unsigned> removed, removedRev;
+    seqs.clear();
+    seqsRev.clear();
     for (auto& read : reads)
     {
         if (seqan::empty(read.seq))
             continue;
+        seqs.push_back(&read.seq);
+        if (!seqan::empty(read.seqRev))
+            seqsRev.push_back(&read.seqRev);
+    }
+    _stripAdapterLanes(seqs, removed, stats, forwardAdapters.adapters, &forwardAdapters.scanners, spec,
+        StripAdapterDirection<adapterDirection::forward>());
+    _stripAdapterLanes(seqsRev, removedRev, stats, reverseAdapters.adapters, &reverseAdapters.scanners, spec,
+        StripAdapterDirection<adapterDirection::reverse>());
+    if (!TTagAdapter::value)
+        return;
+    // the reads may be empty now, so they are found by their address
+    unsigned int readNum = 0, readNumRev = 0;
+    for (auto& read : reads)
+    {
         unsigned over = 0;
-        if (pairedNoAdapterFile)
-        {
-            stripPair(read.seq, read.seqRev);
-        }
-        else
-        {
-            over = stripAdapter(read.seq, stats, adapters, spec, StripAdapterDirection<adapterDirection::forward>());
-            if (!seqan::empty(read.seqRev))
-                over += stripAdapter(read.seqRev, stats, adapters, spec, StripAdapterDirection<adapterDirection::reverse>());
-        }
-        if (TTagAdapter::value && over != 0)
+        if (readNum < seqs.size() && seqs[readNum] == &read.seq)
+            over += removed[readNum++];
+        if (readNumRev < seqsRev.size() && seqsRev[readNumRev] == &read.seqRev)
+            over += removedRev[readNumRev++];
+        if (over != 0)
             insertAfterFirstToken(read.id, ":AdapterRemoved");
     }
     return;
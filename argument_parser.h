@@ -31,6 +31,7 @@
 // ==========================================================================
 #pragma once
 
+#include <sstream>
 #include <string>
 
 #include <seqan/sequence.h>
@@ -157,8 +158,22 @@ struct ProgramParams
     unsigned records;
     unsigned int num_threads;
     bool ordered;
-
-    ProgramParams() : fileCount(0), showSpeed(false), firstReads(0), records(0), num_threads(0), ordered(false) {};
+    bool parallelParsing;
+    bool mmap;
+    unsigned int writerThreads;
+    bool stdinInput;
+    bool interleavedInput;
+    bool interleavedOutput;
+    unsigned int batchBytes;    // 0: fixed number of records per batch
+    bool adaptiveBatch;
+    unsigned int shardIndex;    // 0-based
+    unsigned int shardCount;
+    unsigned int checkpointInterval;    // seconds, 0: no checkpoints
+    bool resume;
+
+    ProgramParams() : fileCount(0), showSpeed(false), firstReads(0), records(0), num_threads(0), ordered(false), parallelParsing(false), mmap(false),
+        writerThreads(1), stdinInput(false), interleavedInput(false), interleavedOutput(false), batchBytes(0), adaptiveBatch(false),
+        shardIndex(0), shardCount(1), checkpointInterval(0), resume(false) {};
 };
 
 //Function declarations
@@ -191,7 +206,7 @@ void ArgumentParserBuilder::addGeneralOptions(seqan::ArgumentParser & parser, co
     addOption(parser, showSpeedOpt);
 
     seqan::ArgParseOption writeStatsOpt = seqan::ArgParseOption(
-        "st", "writeStats", "Write statistics into a file");
+        "st", "writeStats", "Write statistics into a file, or only to standard error if the reads are written to standard output.");
     addOption(parser, writeStatsOpt);
 
     seqan::ArgParseOption recordOpt = seqan::ArgParseOption(
@@ -201,6 +216,17 @@ void ArgumentParserBuilder::addGeneralOptions(seqan::ArgumentParser & parser, co
     setMinValue(recordOpt, "1");
     addOption(parser, recordOpt);
 
+    seqan::ArgParseOption batchBytesOpt = seqan::ArgParseOption(
+        "bb", "batchBytes", "Size a batch of reads by its number of input bytes instead of its number of records. "
+        "-r is only used as an upper limit if it is given explicitly.",
+        seqan::ArgParseOption::INTEGER, "BYTES");
+    setMinValue(batchBytesOpt, "1");
+    addOption(parser, batchBytesOpt);
+
+    seqan::ArgParseOption adaptiveBatchOpt = seqan::ArgParseOption(
+        "ab", "adaptiveBatch", "Tune the number of records per batch at runtime for the highest throughput. -r is used as the initial value.");
+    addOption(parser, adaptiveBatchOpt);
+
     seqan::ArgParseOption noQualOpt = seqan::ArgParseOption(
         "nq", "noQualities", "Force .fa format for output files.");
     addOption(parser, noQualOpt);
@@ -222,10 +248,50 @@ void ArgumentParserBuilder::addGeneralOptions(seqan::ArgumentParser & parser, co
     setMinValue(threadOpt, "1");
     addOption(parser, threadOpt);
 
+    seqan::ArgParseOption parallelParsingOpt = seqan::ArgParseOption(
+        "pp", "parallelParsing", "Parse records in the worker threads instead of the reading thread. Gzip compressed input is then inflated in an extra thread per file, BGZF input by up to THREADS extra threads. Only for FASTQ with four lines per record and FASTA input and more than one thread.");
+    addOption(parser, parallelParsingOpt);
+
+    seqan::ArgParseOption mmapOpt = seqan::ArgParseOption(
+        "mm", "mmap", "Memory map the input files instead of reading them through a stream buffer. Only for uncompressed FASTQ and FASTA input.");
+    addOption(parser, mmapOpt);
+
+    seqan::ArgParseOption writerThreadsOpt = seqan::ArgParseOption(
+        "wt", "writerThreads", "Number of threads that write the output files. Every output file is always written by the same thread, so this only helps with more than one output file, e.g. when demultiplexing.",
+        seqan::ArgParseOption::INTEGER, "THREADS");
+    setDefaultValue(writerThreadsOpt, 1);
+    setMinValue(writerThreadsOpt, "1");
+    addOption(parser, writerThreadsOpt);
+
+    seqan::ArgParseOption interleavedInputOpt = seqan::ArgParseOption(
+        "ii", "interleavedInput", "The only input file contains paired-end reads, each read is directly followed by its mate.");
+    addOption(parser, interleavedInputOpt);
+
+    seqan::ArgParseOption interleavedOutputOpt = seqan::ArgParseOption(
+        "io", "interleavedOutput", "Write paired-end reads into one output file, each read directly followed by its mate.");
+    addOption(parser, interleavedOutputOpt);
+
+    seqan::ArgParseOption shardOpt = seqan::ArgParseOption(
+        "sh", "shard", "Process only part i of N of the input, e.g. 2/4. The parts are byte ranges of the first input file, "
+        "moved to the next record start. The output file names get the suffix _shard<i>of<N>. Only for uncompressed FASTQ and FASTA files.",
+        seqan::ArgParseOption::STRING, "i/N");
+    addOption(parser, shardOpt);
+
+    seqan::ArgParseOption checkpointOpt = seqan::ArgParseOption(
+        "cp", "checkpoint", "Save the progress every n seconds, so that an interrupted run can be continued with -rs. "
+        "Needs uncompressed FASTQ or FASTA input files and uncompressed or BGZF output files. Implies -od.",
+        seqan::ArgParseOption::INTEGER, "SECONDS");
+    setMinValue(checkpointOpt, "1");
+    addOption(parser, checkpointOpt);
+
+    seqan::ArgParseOption resumeOpt = seqan::ArgParseOption(
+        "rs", "resume", "Continue an interrupted run from its last checkpoint. All other options have to be the same as for the interrupted run.");
+    addOption(parser, resumeOpt);
+
     if (flexiProgram == FlexiProgram::ADAPTER_REMOVAL || flexiProgram == FlexiProgram::FILTERING || flexiProgram == FlexiProgram::QUALITY_CONTROL)
     {
         seqan::ArgParseOption outputOpt = seqan::ArgParseOption(
-            "o", "output", "Name of the output file.",
+            "o", "output", "Name of the output file, - for standard output. Defaults to standard output if the reads are read from standard input.",
             seqan::ArgParseOption::OUTPUT_FILE, "OUTPUT");
         setValidValues(outputOpt, seqan::SeqFileOut::getFileExtensions());
         addOption(parser, outputOpt);
@@ -392,6 +458,10 @@ void ArgumentParserBuilder::addAdapterTrimmingOptions(seqan::ArgumentParser & pa
     setDefaultValue(timesOpt, 1);
     addOption(parser, timesOpt);
 
+    seqan::ArgParseOption gappedOpt = seqan::ArgParseOption(
+        "ga", "gapped", "Allow insertions and deletions in adapter matches. The errors are counted as edits then.");
+    addOption(parser, gappedOpt);
+
     if (flexiProgram != FlexiProgram::ALL_STEPS)
     {
         seqan::ArgParseOption adTagOpt = seqan::ArgParseOption(
@@ -466,7 +536,8 @@ void FilteringParserBuilder::addHeader(seqan::ArgumentParser & parser)
     seqan::ArgParseArgument fileArg(seqan::ArgParseArgument::INPUT_FILE, "READS", true);
     setValidValues(fileArg, seqan::SeqFileIn::getFileExtensions());
     addArgument(parser, fileArg);
-    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files.");
+    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files. The mates of a pair need the same id up to the first whitespace, "
+        "apart from a trailing /1 or /2, comments like the Casava 1:N:0 and 2:N:0 may differ. Use - to read FASTQ (optionally gzip compressed) from standard input.");
 }
 
 void AdapterRemovalParserBuilder::addHeader(seqan::ArgumentParser & parser)
@@ -490,7 +561,8 @@ void AdapterRemovalParserBuilder::addHeader(seqan::ArgumentParser & parser)
     seqan::ArgParseArgument fileArg(seqan::ArgParseArgument::INPUT_FILE, "READS", true);
     setValidValues(fileArg, seqan::SeqFileIn::getFileExtensions());
     addArgument(parser, fileArg);
-    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files.");
+    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files. The mates of a pair need the same id up to the first whitespace, "
+        "apart from a trailing /1 or /2, comments like the Casava 1:N:0 and 2:N:0 may differ. Use - to read FASTQ (optionally gzip compressed) from standard input.");
 }
 
 void DemultiplexingParserBuilder::addHeader(seqan::ArgumentParser & parser)
@@ -513,7 +585,8 @@ void DemultiplexingParserBuilder::addHeader(seqan::ArgumentParser & parser)
     seqan::ArgParseArgument fileArg(seqan::ArgParseArgument::INPUT_FILE, "READS", true);
     setValidValues(fileArg, seqan::SeqFileIn::getFileExtensions());
     addArgument(parser, fileArg);
-    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files.");
+    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files. The mates of a pair need the same id up to the first whitespace, "
+        "apart from a trailing /1 or /2, comments like the Casava 1:N:0 and 2:N:0 may differ. Use - to read FASTQ (optionally gzip compressed) from standard input.");
 }
 
 void QualityControlParserBuilder::addHeader(seqan::ArgumentParser & parser)
@@ -535,7 +608,8 @@ void QualityControlParserBuilder::addHeader(seqan::ArgumentParser & parser)
     seqan::ArgParseArgument fileArg(seqan::ArgParseArgument::INPUT_FILE, "READS", true);
     setValidValues(fileArg, seqan::SeqFileIn::getFileExtensions());
     addArgument(parser, fileArg);
-    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files.");
+    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files. The mates of a pair need the same id up to the first whitespace, "
+        "apart from a trailing /1 or /2, comments like the Casava 1:N:0 and 2:N:0 may differ. Use - to read FASTQ (optionally gzip compressed) from standard input.");
 }
 
 void AllStepsParserBuilder::addHeader(seqan::ArgumentParser & parser)
@@ -564,7 +638,8 @@ void AllStepsParserBuilder::addHeader(seqan::ArgumentParser & parser)
     seqan::ArgParseArgument fileArg(seqan::ArgParseArgument::INPUT_FILE, "READS", true);
     setValidValues(fileArg, seqan::SeqFileIn::getFileExtensions());
     addArgument(parser, fileArg);
-    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files.");
+    setHelpText(parser, 0, "Either one (single-end) or two (paired-end) read files. The mates of a pair need the same id up to the first whitespace, "
+        "apart from a trailing /1 or /2, comments like the Casava 1:N:0 and 2:N:0 may differ. Use - to read FASTQ (optionally gzip compressed) from standard input.");
 }
 
 // --------------------------------------------------------------------------
@@ -651,7 +726,7 @@ int loadDemultiplexingParams(seqan::ArgumentParser const& parser, Demultiplexing
 int loadAdapterTrimmingParams(seqan::ArgumentParser const& parser, AdapterTrimmingParams & params)
 {
     // PAIRED-END ------------------------------
-    int fileCount = getArgumentValueCount(parser, 0);
+    const int fileCount = isSet(parser, "ii") ? 2 : getArgumentValueCount(parser, 0);  // interleaved input is paired as well
     // Only consider paired-end mode if two files are given and user wants paired mode.
     params.pairedNoAdapterFile = fileCount == 2 && isSet(parser, "pa");
     // Set run flag, depending on essential parameters.
@@ -669,6 +744,7 @@ int loadAdapterTrimmingParams(seqan::ArgumentParser const& parser, AdapterTrimmi
     getOptionValue(oh, parser, "oh");
     getOptionValue(times, parser, "times");
     params.mode = AdapterMatchSettings(o, e, er, oh, times);
+    params.mode.gapped = isSet(parser, "ga");
 
     // ADAPTER SEQUENCES ----------------------------
     std::string adapterFile, id;
@@ -704,6 +780,8 @@ int loadAdapterTrimmingParams(seqan::ArgumentParser const& parser, AdapterTrimmi
             adapterItem.id = adapterId++;
             seqan::appendValue(params.adapters, adapterItem);
         }
+        buildAdapterTable(params.forwardAdapters, params.adapters, false, params.mode);
+        buildAdapterTable(params.reverseAdapters, params.adapters, true, params.mode);
     }
     // If they are not given, but we would need them (single-end trimming), output error.
     else if ((isSet(parser, "pa") && fileCount == 1))
@@ -749,8 +827,15 @@ int loadQualityTrimmingParams(seqan::ArgumentParser const & parser, QualityTrimm
     return 0;
 }
 
+// "-" is standard input, which is always FASTQ. It is opened at the end of loadProgramParams, once it is known
+// whether it is read through the chunked reader (see openChunker).
 int openStream(seqan::CharString const & file, seqan::SeqFileIn & inFile)
 {
+    if (file == "-")
+    {
+        setFormat(inFile, seqan::Fastq());
+        return 0;
+    }
     if (!open(inFile, seqan::toCString(file)))
     {
         std::cerr << "Error while opening input file '" << file << "'.\n";
@@ -759,6 +844,116 @@ int openStream(seqan::CharString const & file, seqan::SeqFileIn & inFile)
     return 0;
 }
 
+// Opens file again for the chunked reader. Returns false if the file can not be used for chunked reading.
+// Compressed files are never mapped, they are inflated by numThreads threads instead (BGZF) or by one thread (gzip).
+bool openChunker(seqan::CharString const & file, seqan::SeqFileIn & inFile, const bool mapped, const unsigned int numThreads,
+    std::unique_ptr<FastqChunker>& chunker)
+{
+    RecordFormat recordFormat;
+    if (!getRecordFormat(inFile, recordFormat))
+        return false;
+
+    if (file == "-")
+    {
+        auto source = openStdinSource();
+        if (!source)
+            return false;
+        chunker = std::make_unique<FastqChunker>(std::move(source), recordFormat);
+        return true;
+    }
+    std::FILE* rawFile = std::fopen(seqan::toCString(file), "rb");
+    if (rawFile == nullptr)
+        return false;
+    if (isCompressed(rawFile))
+    {
+#if SEQAN_HAS_ZLIB
+        if (isBgzf(rawFile))
+            chunker = std::make_unique<FastqChunker>(std::make_unique<BgzfInputSource>(rawFile, numThreads), recordFormat);
+        else
+            chunker = std::make_unique<FastqChunker>(std::make_unique<GzipInputSource>(rawFile), recordFormat);
+        return true;
+#else
+        (void)numThreads;
+        std::fclose(rawFile);
+        return false;
+#endif
+    }
+    if (mapped)
+    {
+        std::fclose(rawFile);
+        auto mapping = std::make_unique<MappedFile>();
+        if (!mapping->open(seqan::toCString(file)))
+            return false;
+        chunker = std::make_unique<FastqChunker>(std::move(mapping), recordFormat);
+        return true;
+    }
+    chunker = std::make_unique<FastqChunker>(std::make_unique<FileInputSource>(rawFile), recordFormat);
+    return true;
+}
+
+bool getRecordFormat(seqan::SeqFileIn & inFile, RecordFormat& recordFormat)
+{
+    if (value(format(inFile)) == seqan::Find<seqan::FileFormat<seqan::SeqFileIn>::Type, seqan::Fastq>::VALUE)
+        recordFormat = RecordFormat::fastq;
+    else if (value(format(inFile)) == seqan::Find<seqan::FileFormat<seqan::SeqFileIn>::Type, seqan::Fasta>::VALUE)
+        recordFormat = RecordFormat::fasta;
+    else
+        return false;
+    return true;
+}
+
+// Opens the chunkers for one shard. The shard is a byte range of the first file. The range of the second file of a pair
+// starts and ends at the mates of the records at the shard borders, which are looked up by their ids around the same
+// relative position of the second file. Only if a mate is not found there, the records in front of the border are
+// counted in both files, which scans (but does not parse) them.
+bool openShardChunkers(seqan::CharString const & fileName1, seqan::CharString const & fileName2, const unsigned int fileCount,
+    const unsigned int shardIndex, const unsigned int shardCount, InputFileStreams& vars)
+{
+    RecordFormat recordFormat;
+    if (!getRecordFormat(vars.fileStream1, recordFormat))
+        return false;
+    std::FILE* file1 = std::fopen(seqan::toCString(fileName1), "rb");
+    std::FILE* file2 = fileCount == 2 ? std::fopen(seqan::toCString(fileName2), "rb") : nullptr;
+    if (file1 == nullptr || (fileCount == 2 && file2 == nullptr) || isCompressed(file1) || (file2 != nullptr && isCompressed(file2)))
+    {
+        if (file1 != nullptr)
+            std::fclose(file1);
+        if (file2 != nullptr)
+            std::fclose(file2);
+        return false;
+    }
+    const auto size = fileSize(file1);
+    const auto begin = nextRecordStart(file1, size * shardIndex / shardCount, size, recordFormat, vars.interleaved);
+    const auto end = nextRecordStart(file1, size * (shardIndex + 1) / shardCount, size, recordFormat, vars.interleaved);
+    if (file2 != nullptr)
+    {
+        const auto size2 = fileSize(file2);
+        auto mateStart = [&](const std::uint64_t offset) {
+            if (offset >= size)
+                return size2;
+            if (offset == 0)
+                return offset;
+            const auto id = recordId(file1, offset);
+            const auto position = static_cast<std::uint64_t>(static_cast<double>(offset) / size * size2);
+            for (std::uint64_t window = 1 << 20; window <= (1 << 26); window *= 4)
+            {
+                const auto mate = findMateRecord(file2, id, position, size2, recordFormat, window);
+                if (mate != size2)
+                    return mate;
+            }
+            const auto all = std::numeric_limits<std::uint64_t>::max();
+            std::uint64_t records, numRecords;
+            scanRecords(file1, 0, offset, all, recordFormat, records);
+            return scanRecords(file2, 0, all, records, recordFormat, numRecords);
+        };
+        const auto begin2 = mateStart(begin);
+        const auto end2 = std::max(begin2, mateStart(end));
+        vars.chunker2 = std::make_unique<FastqChunker>(std::make_unique<FileRangeInputSource>(file2, begin2, end2), recordFormat, begin2);
+    }
+    vars.chunker1 = std::make_unique<FastqChunker>(std::make_unique<FileRangeInputSource>(file1, begin, end), recordFormat, begin);
+    return true;
+}
+
 int loadProgramParams(seqan::ArgumentParser const & parser, ProgramParams& params, InputFileStreams& vars)
 {
     params.fileCount = getArgumentValueCount(parser, 0);
@@ -781,7 +976,26 @@ int loadProgramParams(seqan::ArgumentParser const & parser, ProgramParams& param
             std::cerr << "Input files must have the same file format.\n";
             return 1;
         }
+        if (fileName1 == "-" && fileName2 == "-")
+        {
+            std::cerr << "Only one input file can be read from standard input.\n";
+            return 1;
+        }
     }
+    params.stdinInput = fileName1 == "-" || fileName2 == "-";
+    params.interleavedInput = isSet(parser, "ii");
+    params.interleavedOutput = isSet(parser, "io");
+    if (params.interleavedInput && params.fileCount == 2)
+    {
+        std::cerr << "Interleaved input requires exactly one input file.\n";
+        return 1;
+    }
+    if (params.interleavedOutput && params.fileCount == 1 && !params.interleavedInput)
+    {
+        std::cerr << "Interleaved output requires paired-end input.\n";
+        return 1;
+    }
+    vars.interleaved = params.interleavedInput;
     params.showSpeed = isSet(parser, "ss");
 
     params.firstReads = std::numeric_limits<unsigned>::max();
@@ -793,7 +1007,94 @@ int loadProgramParams(seqan::ArgumentParser const & parser, ProgramParams& param
     omp_set_num_threads(params.num_threads);
 
     getOptionValue(params.records, parser, "r");
+    params.adaptiveBatch = isSet(parser, "ab");
+    if (params.adaptiveBatch && isSet(parser, "bb"))
+    {
+        std::cerr << "Adaptive batches can not be combined with a byte budget per batch.\n";
+        return 1;
+    }
+    if (isSet(parser, "bb"))
+    {
+        getOptionValue(params.batchBytes, parser, "bb");
+        if (!isSet(parser, "r"))
+            params.records = std::numeric_limits<unsigned>::max();
+    }
     getOptionValue(params.ordered, parser, "od");
+    getOptionValue(params.writerThreads, parser, "wt");
+    getOptionValue(params.checkpointInterval, parser, "cp");
+    params.resume = isSet(parser, "rs");
+    const bool checkpoints = params.checkpointInterval != 0 || params.resume;
+    if (checkpoints)
+    {
+        if (params.stdinInput || isCompressed(seqan::toCString(fileName1)) ||
+            (params.fileCount == 2 && isCompressed(seqan::toCString(fileName2))))
+        {
+            std::cerr << "Checkpoints need uncompressed input files.\n";
+            return 1;
+        }
+        params.ordered = true;  // a checkpoint is only consistent if the batches are written in input order
+    }
+
+    if (isSet(parser, "sh"))
+    {
+        std::string shard;
+        getOptionValue(shard, parser, "sh");
+        std::istringstream shardStream(shard);
+        unsigned int i = 0;
+        char separator = 0;
+        if (!(shardStream >> i >> separator >> params.shardCount) || separator != '/' || !shardStream.eof() || i < 1 || i > params.shardCount)
+        {
+            std::cerr << "Invalid shard " << shard << ", expected i/N with 1 <= i <= N.\n";
+            return 1;
+        }
+        params.shardIndex = i - 1;
+        if (params.stdinInput)
+        {
+            std::cerr << "Standard input can not be sharded.\n";
+            return 1;
+        }
+        if (!openShardChunkers(fileName1, fileName2, params.fileCount, params.shardIndex, params.shardCount, vars))
+        {
+            std::cerr << "Sharding is only supported for uncompressed FASTQ and FASTA files.\n";
+            return 1;
+        }
+        params.parallelParsing = params.num_threads > 1;
+        return 0;
+    }
+
+    // with -pp compressed input is also inflated in separate threads, multi-line FASTQ needs the sequential parser
+    params.parallelParsing = isSet(parser, "pp") && params.num_threads > 1;
+    params.mmap = isSet(parser, "mm");
+    if (params.parallelParsing || params.mmap || checkpoints)   // checkpoints need the input offsets of the chunkers
+    {
+        const unsigned int inflateThreads = std::max(1u, params.num_threads / params.fileCount);
+        if (!openChunker(fileName1, vars.fileStream1, params.mmap, inflateThreads, vars.chunker1) ||
+            (params.fileCount == 2 && !openChunker(fileName2, vars.fileStream2, params.mmap, inflateThreads, vars.chunker2)))
+        {
+            vars.chunker1.reset();
+            vars.chunker2.reset();
+            if (params.stdinInput)
+            {
+                std::cerr << "Could not read the input files. Standard input has to be FASTQ, gzip compressed FASTQ needs zlib support.\n";
+                return 1;
+            }
+            if (checkpoints)
+            {
+                std::cerr << "Checkpoints are only supported for FASTQ and FASTA files.\n";
+                return 1;
+            }
+            params.parallelParsing = params.mmap = false;
+            std::cout << "\nParallel parsing and memory mapping are only supported for FASTQ and FASTA files, reads are parsed sequentially.\n";
+        }
+        else
+            params.mmap = vars.chunker1->isMapped();
+    }
+    // without the chunked reader standard input is parsed by seqan, which also accepts multi-line FASTQ
+    if (params.stdinInput && !vars.chunker1 && !open(fileName1 == "-" ? vars.fileStream1 : vars.fileStream2, std::cin, seqan::Fastq()))
+    {
+        std::cerr << "Could not read from standard input.\n";
+        return 1;
+    }
     return 0;
 }
 
@@ -0,0 +1,172 @@
+// ==========================================================================
+//                                   bgzf.h
+// ==========================================================================
+// Copyright (c) 2006-2015, Knut Reinert, FU Berlin
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Knut Reinert or the FU Berlin nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL KNUT REINERT OR THE FU BERLIN BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// ==========================================================================
+// Author: Benjamin Menkuec <benjamin@menkuec.de>
+// ==========================================================================
+
+#pragma once
+
+#if SEQAN_HAS_ZLIB
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include <zlib.h>
+
+// BGZF files are a series of gzip members, each of them holding at most 64 KB of data.
+// The size of every compressed block is stored in the 'BC' extra field of its gzip header,
+// so the blocks can be located without inflating them and decompressed independently.
+
+constexpr std::size_t bgzfHeaderSize = 12;      // fixed part of the gzip header, without extra fields
+constexpr std::size_t bgzfFooterSize = 8;       // crc32 and uncompressed size
+constexpr std::size_t bgzfMaxBlockData = 65280; // even incompressible data fits into one block of at most 64 KB
+
+// empty block which marks the end of a BGZF file
+constexpr unsigned char bgzfEofBlock[28] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+inline unsigned int readLE16(const unsigned char* data) noexcept
+{
+    return data[0] | (data[1] << 8);
+}
+
+inline unsigned long readLE32(const unsigned char* data) noexcept
+{
+    return static_cast<unsigned long>(data[0]) | (static_cast<unsigned long>(data[1]) << 8) |
+        (static_cast<unsigned long>(data[2]) << 16) | (static_cast<unsigned long>(data[3]) << 24);
+}
+
+inline void writeLE32(unsigned char* data, const unsigned long value) noexcept
+{
+    for (unsigned int i = 0; i < 4; ++i)
+        data[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+// checks if the file starts with a BGZF block, without consuming anything
+inline bool isBgzf(std::FILE* file) noexcept
+{
+    unsigned char header[18];
+    const auto numRead = std::fread(header, 1, sizeof(header), file);
+    std::rewind(file);
+    return numRead == sizeof(header) && header[0] == 0x1f && header[1] == 0x8b && header[2] == 8 && (header[3] & 4) != 0 &&
+        readLE16(header + 10) >= 6 && header[12] == 'B' && header[13] == 'C' && readLE16(header + 14) == 2;
+}
+
+// Reads the next compressed block into block. Returns false at the end of the file.
+inline bool readBgzfBlock(std::FILE* file, std::vector<unsigned char>& block)
+{
+    block.resize(bgzfHeaderSize);
+    const auto numRead = std::fread(block.data(), 1, bgzfHeaderSize, file);
+    if (numRead == 0)
+        return false;
+    if (numRead != bgzfHeaderSize || block[0] != 0x1f || block[1] != 0x8b || (block[3] & 4) == 0)
+        throw std::runtime_error("Invalid BGZF block header.");
+    const auto extraLength = readLE16(block.data() + 10);
+    block.resize(bgzfHeaderSize + extraLength);
+    if (std::fread(block.data() + bgzfHeaderSize, 1, extraLength, file) != extraLength)
+        throw std::runtime_error("Truncated BGZF block header.");
+
+    std::size_t blockSize = 0;
+    for (std::size_t pos = bgzfHeaderSize; pos + 4 <= block.size();)
+    {
+        const auto fieldLength = readLE16(block.data() + pos + 2);
+        if (block[pos] == 'B' && block[pos + 1] == 'C' && fieldLength == 2 && pos + 6 <= block.size())
+            blockSize = readLE16(block.data() + pos + 4) + 1;
+        pos += 4 + fieldLength;
+    }
+    if (blockSize < bgzfHeaderSize + extraLength + bgzfFooterSize)
+        throw std::runtime_error("Invalid BGZF block size.");
+    const auto headerLength = block.size();
+    block.resize(blockSize);
+    if (std::fread(block.data() + headerLength, 1, blockSize - headerLength, file) != blockSize - headerLength)
+        throw std::runtime_error("Truncated BGZF block.");
+    return true;
+}
+
+// Decompresses a complete block as read by readBgzfBlock.
+inline std::vector<char> inflateBgzfBlock(const std::vector<unsigned char>& block)
+{
+    const auto dataBegin = bgzfHeaderSize + readLE16(block.data() + 10);
+    const auto dataEnd = block.size() - bgzfFooterSize;
+    const auto crc = readLE32(block.data() + dataEnd);
+    const auto uncompressedSize = readLE32(block.data() + dataEnd + 4);
+
+    std::vector<char> data(uncompressedSize);
+    if (uncompressedSize == 0)
+        return data;    // end of file marker
+    z_stream stream = z_stream();
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)     // raw deflate data
+        throw std::runtime_error("Could not initialize zlib.");
+    stream.next_in = const_cast<Bytef*>(block.data() + dataBegin);
+    stream.avail_in = static_cast<uInt>(dataEnd - dataBegin);
+    stream.next_out = reinterpret_cast<Bytef*>(data.data());
+    stream.avail_out = static_cast<uInt>(data.size());
+    const int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END || stream.avail_out != 0 ||
+        crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(data.data()), static_cast<uInt>(data.size())) != crc)
+        throw std::runtime_error("Corrupt BGZF block.");
+    return data;
+}
+
+// Compresses at most bgzfMaxBlockData bytes into one complete block.
+inline std::vector<unsigned char> deflateBgzfBlock(const std::vector<char>& data, const int level = Z_DEFAULT_COMPRESSION)
+{
+    if (data.size() > bgzfMaxBlockData)
+        throw std::runtime_error("Too much data for one BGZF block.");
+    const unsigned char header[18] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0 };
+    std::vector<unsigned char> block(sizeof(header) + compressBound(static_cast<uLong>(data.size())) + bgzfFooterSize);
+    std::copy(header, header + sizeof(header), block.begin());
+
+    z_stream stream = z_stream();
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)    // raw deflate data
+        throw std::runtime_error("Could not initialize zlib.");
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = block.data() + sizeof(header);
+    stream.avail_out = static_cast<uInt>(block.size() - sizeof(header) - bgzfFooterSize);
+    const int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    const auto blockSize = sizeof(header) + stream.total_out + bgzfFooterSize;
+    if (ret != Z_STREAM_END || blockSize > 65536)
+        throw std::runtime_error("Could not compress BGZF block.");
+
+    block.resize(blockSize);
+    block[16] = static_cast<unsigned char>((blockSize - 1) & 0xff);
+    block[17] = static_cast<unsigned char>((blockSize - 1) >> 8);
+    writeLE32(block.data() + blockSize - bgzfFooterSize,
+        crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(data.data()), static_cast<uInt>(data.size())));
+    writeLE32(block.data() + blockSize - 4, static_cast<unsigned long>(data.size()));
+    return block;
+}
+
+#endif  // SEQAN_HAS_ZLIB
@@ -0,0 +1,250 @@
+// ==========================================================================
+//                                checkpoint.h
+// ==========================================================================
+// Copyright (c) 2006-2015, Knut Reinert, FU Berlin
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Knut Reinert or the FU Berlin nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL KNUT REINERT OR THE FU BERLIN BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// ==========================================================================
+// Author: Benjamin Menkuec <benjamin@menkuec.de>
+// ==========================================================================
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#undef min
+#undef max
+#else
+#include <unistd.h>
+#endif
+
+#include "helper_functions.h"
+#include "general_stats.h"
+
+// A consistent state of a run: all records in front of the input offsets have been processed
+// and written into the first bytes of the output files, none of the later records has.
+struct Checkpoint
+{
+    std::uint64_t records;          // records (pairs for paired-end input) that have been processed
+    std::uint64_t inputOffset1;     // begin of the first unprocessed record in each input file
+    std::uint64_t inputOffset2;
+    std::vector<std::pair<std::string, std::uint64_t>> outputs;    // output files and their length
+    GeneralStats stats;
+
+    Checkpoint() : records(0), inputOffset1(0), inputOffset2(0) {};
+};
+
+template <typename T>
+void writeValues(std::ostream& stream, const std::string& key, const std::vector<T>& values)
+{
+    stream << key << " " << values.size();
+    for (const auto& value : values)
+        stream << " " << value;
+    stream << "\n";
+}
+
+template <typename T>
+bool readValues(std::istream& stream, const std::string& key, std::vector<T>& values)
+{
+    std::string line, lineKey;
+    std::size_t size = 0;
+    if (!std::getline(stream, line))
+        return false;
+    std::istringstream lineStream(line);
+    if (!(lineStream >> lineKey >> size) || lineKey != key)
+        return false;
+    values.resize(size);
+    for (auto& value : values)
+        lineStream >> value;
+    return !lineStream.fail();
+}
+
+// The checkpoint is written into a temporary file first, which is synced to disk and then replaces the old checkpoint.
+// So there is always a complete checkpoint, even if the program is killed or the system goes down while writing it.
+// The output files are only flushed, after a system crash they can be shorter than the checkpoint says.
+inline void saveCheckpoint(const std::string& fileName, const Checkpoint& checkpoint)
+{
+    const std::string tmpName = fileName + ".tmp";
+    std::ostringstream stream;
+    const auto& stats = checkpoint.stats;
+    const auto& adapterStats = stats.adapterTrimmingStats;
+    stream << "flexcat checkpoint 1\n";
+    stream << "input " << checkpoint.records << " " << checkpoint.inputOffset1 << " " << checkpoint.inputOffset2 << "\n";
+    stream << "stats " << stats.removedN << " " << stats.removedDemultiplex << " " << stats.removedQuality << " " << stats.uncalledBases << " "
+        << stats.removedShort << " " << stats.readCount << " " << stats.ioTime << "\n";
+    writeValues(stream, "barcodes", stats.matchedBarcodeReads);
+    stream << "overlaps " << adapterStats.overlapSum << " " << adapterStats.minOverlap << " " << adapterStats.maxOverlap << "\n";
+    writeValues(stream, "removed", adapterStats.numRemoved);
+    stream << "lengths " << adapterStats.removedLength.size() << "\n";
+    for (const auto& lengths : adapterStats.removedLength)
+        writeValues(stream, "length", lengths);
+    stream << "outputs " << checkpoint.outputs.size() << "\n";
+    for (const auto& output : checkpoint.outputs)
+        stream << output.second << " " << output.first << "\n";   // the name is last, it may contain spaces
+    const auto text = stream.str();
+    std::FILE* tmpFile = std::fopen(tmpName.c_str(), "w");
+    if (tmpFile == nullptr)
+        throw std::runtime_error("Could not write checkpoint file " + tmpName);
+    bool written = std::fwrite(text.data(), 1, text.size(), tmpFile) == text.size() && std::fflush(tmpFile) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(tmpFile)) == 0;
+#else
+    written = written && fsync(fileno(tmpFile)) == 0;
+#endif
+    if (std::fclose(tmpFile) != 0 || !written)
+        throw std::runtime_error("Could not write checkpoint file " + tmpName);
+#ifdef _WIN32
+    if (!MoveFileExA(tmpName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+    if (std::rename(tmpName.c_str(), fileName.c_str()) != 0)
+#endif
+        throw std::runtime_error("Could not write checkpoint file " + fileName);
+}
+
+inline bool loadCheckpoint(const std::string& fileName, Checkpoint& checkpoint)
+{
+    std::ifstream file(fileName);
+    std::string line, key;
+    if (!std::getline(file, line) || line != "flexcat checkpoint 1")
+        return false;
+    auto& stats = checkpoint.stats;
+    auto& adapterStats = stats.adapterTrimmingStats;
+    std::size_t numLengths = 0, numOutputs = 0;
+    if (!(file >> key >> checkpoint.records >> checkpoint.inputOffset1 >> checkpoint.inputOffset2) || key != "input" ||
+        !(file >> key >> stats.removedN >> stats.removedDemultiplex >> stats.removedQuality >> stats.uncalledBases
+            >> stats.removedShort >> stats.readCount >> stats.ioTime) || key != "stats")
+        return false;
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (!readValues(file, "barcodes", stats.matchedBarcodeReads) ||
+        !(file >> key >> adapterStats.overlapSum >> adapterStats.minOverlap >> adapterStats.maxOverlap) || key != "overlaps")
+        return false;
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (!readValues(file, "removed", adapterStats.numRemoved) || !(file >> key >> numLengths) || key != "lengths")
+        return false;
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    adapterStats.removedLength.resize(numLengths);
+    for (auto& lengths : adapterStats.removedLength)
+        if (!readValues(file, "length", lengths))
+            return false;
+    if (!(file >> key >> numOutputs) || key != "outputs")
+        return false;
+    checkpoint.outputs.resize(numOutputs);
+    for (auto& output : checkpoint.outputs)
+    {
+        if (!(file >> output.second) || file.get() != ' ' || !std::getline(file, output.first))
+            return false;
+    }
+    return true;
+}
+
+// Takes a checkpoint after a batch has been written, if the last one is older than the interval.
+// The reader reports the input offsets after every batch, the writer the number of records that
+// have been written. As the batches are written in the order in which they have been read, the
+// output files are consistent with the input offsets after each batch.
+class Checkpointer
+{
+    const std::string _fileName;
+    const std::chrono::duration<double> _interval;  // 0: only the final state of a resumed run is kept
+    const Checkpoint _resumed;      // state at the start of this run
+    std::mutex _mutex;
+    std::deque<std::tuple<std::uint64_t, std::uint64_t, std::uint64_t>> _batchEnds;   // records read so far, input offsets
+    std::chrono::steady_clock::time_point _lastCheckpoint;
+    std::atomic_bool _stopped;      // set after an input error, the written batches no longer match the batch ends
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+public:
+    Checkpointer(std::string fileName, const unsigned int intervalSeconds, Checkpoint resumed)
+        : _fileName(std::move(fileName)), _interval(intervalSeconds), _resumed(std::move(resumed)),
+        _lastCheckpoint(std::chrono::steady_clock::now()), _stopped(false) {};
+
+    inline const Checkpoint& resumed() const noexcept
+    {
+        return _resumed;
+    }
+
+    inline const std::string& fileName() const noexcept
+    {
+        return _fileName;
+    }
+
+    // no further checkpoints are saved, the last saved one stays valid for resuming
+    void stop() noexcept
+    {
+        _stopped = true;
+    }
+
+    // called by the reader, records counts the records of this run
+    void batchRead(const std::uint64_t records, const std::uint64_t inputOffset1, const std::uint64_t inputOffset2)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batchEnds.emplace_back(records, inputOffset1, inputOffset2);
+    }
+
+    // called by the writer, with the statistics of all batches of this run that have been written
+    template <typename TOutputStreams>
+    void batchWritten(const GeneralStats& stats, TOutputStreams& outputStreams)
+    {
+        if (_stopped)
+            return;
+        Checkpoint checkpoint;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (!_batchEnds.empty() && std::get<0>(_batchEnds.front()) < stats.readCount)
+                _batchEnds.pop_front();
+            if (_batchEnds.empty() || std::get<0>(_batchEnds.front()) != stats.readCount)
+                throw std::runtime_error("Checkpoints need the batches to be written in input order.");
+            std::tie(checkpoint.records, checkpoint.inputOffset1, checkpoint.inputOffset2) = _batchEnds.front();
+            _batchEnds.pop_front();
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (_interval.count() == 0 || now - _lastCheckpoint < _interval)
+            return;
+        checkpoint.records += _resumed.records;
+        checkpoint.outputs = outputStreams.flush();
+        checkpoint.stats = _resumed.stats;
+        checkpoint.stats += stats;
+        saveCheckpoint(_fileName, checkpoint);
+        _lastCheckpoint = now;
+    }
+};
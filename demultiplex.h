@@ -189,10 +189,11 @@ void clipBarcodes(std::vector<TRead>& reads, const unsigned len, const ClipHard&
 template<typename TRead>
 void clipBarcodes(std::vector<TRead>& reads, const int len, const ClipSoft&) noexcept
 {
-    // unmatched reads are partitioned to the end
-    std::for_each(reads.begin(), std::find_if(reads.begin(), reads.end(), [](const auto& read)->auto {return read.demuxResult == 0;}), [len](auto& read) {
-        erase(read.seq, 0, len);
-    });
+    for (auto& read : reads)
+    {
+        if (read.demuxResult != 0)
+            erase(read.seq, 0, len);
+    }
 }
 
 struct ApproximateBarcodeMatching {};
@@ -238,10 +239,9 @@ void demultiplex(std::vector<TRead<TSeq>>& reads, const TFinder& finder,
     const bool hardClip, TStats& stats, const TApprox& approximate, const bool exclude)
 {
     MatchBarcodes(reads, finder, stats, approximate);
+    // the reads are not reordered, the writer sorts them into one bucket per barcode
     if (exclude)
         reads.erase(std::remove_if(reads.begin(), reads.end(), [](const auto& read)->auto {return read.demuxResult == 0;}), reads.end());
-    else
-        std::partition(reads.begin(), reads.end(), [](const auto& read)->auto {return read.demuxResult != 0;});
 
     if (std::is_same<TRead<TSeq>, Read<TSeq>>::value || std::is_same<TRead<TSeq>, ReadPairedEnd<TSeq>>::value)   // clipping is not done for multiplex barcodes, only for inline barcodes
     {
@@ -40,8 +40,10 @@
 #define DEBUG_MSG(str) do { } while ( false )
 #endif
 
+#include <atomic>
 #include <iostream>
 #include <future>
+#include <mutex>
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
 #include <seqan/seq_io.h>
@@ -57,6 +59,7 @@
 #include "flexcat.h"
 #include "flexlib.h"
 #include "argument_parser.h"
+#include "checkpoint.h"
 #include "read_trimming.h"
 #include "adapter_trimming.h"
 #include "demultiplex.h"
@@ -87,7 +90,7 @@ inline void loadMultiplex(std::vector<TRead<TSeq>>& reads, unsigned records, seq
 {
     seqan::String<char> id;
     unsigned int i = 0;
-    while (i < records && !atEnd(multiplexFile))
+    while (i < records && i < reads.size() && !atEnd(multiplexFile))   // the last batch can be smaller
     {
         readRecord(id, reads[i].demultiplex, multiplexFile);
         ++i;
@@ -143,9 +146,11 @@ void adapterTrimmingStage(const AdapterTrimmingParams& params, std::vector<TRead
     if (!params.run)
         return;
     if(params.tag)
-        stripAdapterBatch(reads, params.adapters, params.mode, params.pairedNoAdapterFile, stats.adapterTrimmingStats, TagAdapter<true>());
+        stripAdapterBatch(reads, params.forwardAdapters, params.reverseAdapters, params.mode, params.pairedNoAdapterFile,
+            stats.adapterTrimmingStats, TagAdapter<true>());
     else
-        stripAdapterBatch(reads, params.adapters, params.mode, params.pairedNoAdapterFile, stats.adapterTrimmingStats, TagAdapter<false>());
+        stripAdapterBatch(reads, params.forwardAdapters, params.reverseAdapters, params.mode, params.pairedNoAdapterFile,
+            stats.adapterTrimmingStats, TagAdapter<false>());
 }
 
 // QUALITY TRIMMING
@@ -192,7 +197,7 @@ template <typename TOutStream, typename TStats>
 void printStatistics(const ProgramParams& programParams, const TStats& generalStats, DemultiplexingParams& demultiplexParams,
                 const AdapterTrimmingParams& adapterParams, const bool timing, TOutStream &outStream)
 {
-    bool paired = programParams.fileCount == 2;
+    bool paired = programParams.fileCount == 2 || programParams.interleavedInput;
     bool adapter = adapterParams.run;
     outStream << std::endl;
     outStream << "\r\rRead statistics\n";
@@ -328,11 +333,9 @@ unsigned int readReads(std::vector<TRead<TSeq>>& reads, const unsigned int recor
 {
     reads.resize(records);
     unsigned int i = 0;
-    TSeq seq;
     while (i < records && !atEnd(inputFileStreams.fileStream1))
     {
-        readRecord(reads[i].id, seq, inputFileStreams.fileStream1);
-        reads[i].seq = seq;
+        readRecord(reads[i].id, reads[i].seq, inputFileStreams.fileStream1);
         ++i;
     }
     reads.resize(i);
@@ -343,39 +346,175 @@ template < template<typename> class TRead, typename TSeq, typename = std::enable
 unsigned int readReads(std::vector<TRead<TSeq>>& reads, const unsigned int records, InputFileStreams& inputFileStreams)
 {
     reads.resize(records);
+    if (inputFileStreams.interleaved)
+    {
+        unsigned int i = 0;
+        while (i < records && !atEnd(inputFileStreams.fileStream1))
+        {
+            readRecord(reads[i].id, reads[i].seq, inputFileStreams.fileStream1);
+            if (atEnd(inputFileStreams.fileStream1))
+                throw std::runtime_error("Interleaved input ends with a read without mate.");
+            readRecord(reads[i].idRev, reads[i].seqRev, inputFileStreams.fileStream1);
+            checkMateIds(reads[i].id, reads[i].idRev);
+            ++i;
+        }
+        reads.resize(i);
+        return i;
+    }
+    // the second mates are read (and decompressed) concurrently, they go to different members of the reads
+    if (!inputFileStreams.mateReader)
+        inputFileStreams.mateReader = std::make_unique<ptc::TaskPool>(1);
+    auto numRevReads = inputFileStreams.mateReader->submit([&reads, records, &inputFileStreams]() {
+        unsigned int i = 0;
+        while (i < records && !atEnd(inputFileStreams.fileStream2))
+        {
+            readRecord(reads[i].idRev, reads[i].seqRev, inputFileStreams.fileStream2);
+            ++i;
+        }
+        return i;
+    });
     unsigned int i = 0;
-    while (i < records && !atEnd(inputFileStreams.fileStream1))
+    try
     {
-        readRecord(reads[i].id, reads[i].seq, inputFileStreams.fileStream1);
-        readRecord(reads[i].idRev, reads[i].seqRev, inputFileStreams.fileStream2);
-        ++i;
+        while (i < records && !atEnd(inputFileStreams.fileStream1))
+        {
+            readRecord(reads[i].id, reads[i].seq, inputFileStreams.fileStream1);
+            ++i;
+        }
+    }
+    catch (...)
+    {
+        numRevReads.wait();     // the reads must not be released while the second mates are still read into them
+        throw;
     }
+    if (numRevReads.get() != i)
+        throw std::runtime_error("Paired-end input files contain a different number of records.");
     reads.resize(i);
+    for (const auto& read : reads)
+        checkMateIds(read.id, read.idRev);
     return i;
 }
 
+// Reads the raw records of the next batch, parsing is done later in the worker threads.
+unsigned int readChunk(RawChunk& chunk, const unsigned int records, InputFileStreams& inputFileStreams)
+{
+    chunk.interleaved = inputFileStreams.interleaved;
+    if (inputFileStreams.interleaved)
+        return inputFileStreams.chunker1->readBlock(chunk.block1, 2 * records) / 2;
+    if (!inputFileStreams.chunker2)
+        return inputFileStreams.chunker1->readBlock(chunk.block1, records);
+    if (!inputFileStreams.mateReader)
+        inputFileStreams.mateReader = std::make_unique<ptc::TaskPool>(1);
+    auto numRevRecords = inputFileStreams.mateReader->submit([&chunk, records, &inputFileStreams]() {
+        return inputFileStreams.chunker2->readBlock(chunk.block2, records);
+    });
+    unsigned int numRecords;
+    try
+    {
+        numRecords = inputFileStreams.chunker1->readBlock(chunk.block1, records);
+    }
+    catch (...)
+    {
+        numRevRecords.wait();
+        throw;
+    }
+    if (numRevRecords.get() != numRecords)
+        throw std::runtime_error("Paired-end input files contain a different number of records.");
+    return numRecords;
+}
+
 // END FUNCTION DEFINITIONS ---------------------------------------------
 template<template <typename> class TRead, typename TSeq, typename TEsaFinder, typename TStats>
 int mainLoop(TRead<TSeq>, const ProgramParams& programParams, InputFileStreams& inputFileStreams, const DemultiplexingParams& demultiplexingParams, const ProcessingParams& processingParams, const AdapterTrimmingParams& adapterTrimmingParams,
     const QualityTrimmingParams& qualityTrimmingParams, TEsaFinder& esaFinder,
-    OutputStreams& outputStreams, TStats& stats)
+    OutputStreams& outputStreams, TStats& stats, Checkpointer* checkpointer)
 {
-    using TReadWriter = ReadWriter<OutputStreams, ProgramParams>;
-    TReadWriter readWriter(outputStreams, programParams);
+    // Batches that have been written are reused, the strings of their reads keep their capacity.
+    // There are never more batches alive than the ptc slots plus the batches in the worker threads.
+    const unsigned int poolSize = 3 * programParams.num_threads + 3;
+    using TReadPool = ptc::RecyclePool<std::vector<TRead<TSeq>>>;
+    TReadPool readPool(poolSize);
+    ptc::RecyclePool<RawChunk> chunkPool(poolSize);
+
+    using TReadWriter = ReadWriter<OutputStreams, ProgramParams, TReadPool, Checkpointer>;
+    TReadWriter readWriter(outputStreams, programParams, readPool, checkpointer);
+
+    // checkpoints need the input offsets after each batch, they are only known when reading raw chunks
+    auto batchRead = [&inputFileStreams, checkpointer](const unsigned int numReads) {
+        if (checkpointer)
+            checkpointer->batchRead(numReads, inputFileStreams.chunker1->offset(), inputFileStreams.chunker2 ? inputFileStreams.chunker2->offset() : 0);
+    };
+
+    // The first input error (malformed records, mismatched mates) ends the pipeline, the reader returns
+    // the end signal and the error is reported after all threads have finished.
+    std::mutex errorMutex;
+    std::string inputError;
+    std::atomic_bool failed(false);
+    auto inputFailed = [&errorMutex, &inputError, &failed, checkpointer](const std::exception& e) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!failed)
+            inputError = e.what();
+        failed = true;
+        if (checkpointer)
+            checkpointer->stop();
+    };
 
-    unsigned int numReads = 0;
-    auto readReader = [&numReads, &programParams, &inputFileStreams]() {
-        auto item = std::make_unique<std::vector<TRead<TSeq>>>();
-        if (numReads > programParams.firstReads)    // maximum read number reached -> dont do further reads
+    // the records of a resumed run count towards the maximum read number
+    const auto resumedReads = checkpointer ? static_cast<unsigned int>(checkpointer->resumed().records) : 0u;
+    unsigned int numReads = resumedReads;
+    // an adaptive measurement window spans as many batches as the pipeline can hold
+    BatchSizer batchSizer(programParams.records, programParams.batchBytes, programParams.adaptiveBatch, poolSize);
+    auto readReader = [&numReads, &programParams, &inputFileStreams, &readPool, &batchSizer, &failed, &inputFailed]() {
+        auto item = readPool.get();
+        if (failed || numReads > programParams.firstReads)    // maximum read number reached -> dont do further reads
         {
-            item.release();   // return empty unique_ptr to signal end
+            item.reset();   // return empty unique_ptr to signal end
             return std::move(item);
         }
-        readReads(*item, programParams.records, inputFileStreams);
-        loadMultiplex(*item, programParams.records, inputFileStreams.fileStreamMultiplex);
+        const auto records = batchSizer.records();
+        try
+        {
+            readReads(*item, records, inputFileStreams);
+            loadMultiplex(*item, records, inputFileStreams.fileStreamMultiplex);
+        }
+        catch (const std::exception& e)
+        {
+            inputFailed(e);
+            item.reset();
+            return std::move(item);
+        }
+        batchSizer.update(batchSizer.budgeted() ? batchBytes(*item) : 0, item->size());
         numReads += item->size();
         if (item->empty())    // no more reads available
-            item.release();   // return empty unique_ptr to signal eof
+            item.reset();   // return empty unique_ptr to signal eof
+        return std::move(item);
+    };
+
+    // only splits the input into records, the records are parsed by the chunkTransformer
+    auto chunkReader = [&numReads, resumedReads, &programParams, &inputFileStreams, &chunkPool, &batchSizer, &batchRead, &failed, &inputFailed]() {
+        auto item = chunkPool.get();
+        if (failed || numReads > programParams.firstReads)    // maximum read number reached -> dont do further reads
+        {
+            item.reset();   // return empty unique_ptr to signal end
+            return std::move(item);
+        }
+        unsigned int numRecords;
+        try
+        {
+            numRecords = readChunk(*item, batchSizer.records(), inputFileStreams);
+        }
+        catch (const std::exception& e)
+        {
+            inputFailed(e);
+            item.reset();
+            return std::move(item);
+        }
+        batchSizer.update(batchBytes(*item), numRecords);
+        numReads += numRecords;
+        if (item->block1.records == 0)    // no more reads available
+            item.reset();   // return empty unique_ptr to signal eof
+        else
+            batchRead(numReads - resumedReads);
         return std::move(item);
     };
 
@@ -391,34 +530,75 @@ int mainLoop(TRead<TSeq>, const ProgramParams& programParams, InputFileStreams&
         return std::make_unique<std::tuple<decltype(reads), decltype(demultiplexingParams.barcodeIds), decltype(generalStats) >>(std::make_tuple(std::move(reads), demultiplexingParams.barcodeIds, generalStats));
     };
 
-    TStats generalStats(length(demultiplexingParams.barcodeIds) + 1, adapterTrimmingParams.adapters.size());
+    auto chunkTransformer = [&](std::unique_ptr<RawChunk> chunk) {
+        auto reads = readPool.get();
+        try
+        {
+            parseChunk(*reads, *chunk);
+        }
+        catch (const std::exception& e)     // the batch is dropped, the reader stops at its next call
+        {
+            inputFailed(e);
+            reads->clear();
+        }
+        chunkPool.release(std::move(chunk));
+        return transformer(std::move(reads));
+    };
 
-    if (programParams.num_threads > 1)
-    {
+    auto runPtc = [&](auto& source, const auto& itemTransformer) {
         if (programParams.ordered)
         {
-            auto ptc_unit = ptc::ordered_ptc(readReader, transformer, readWriter, programParams.num_threads);
+            auto ptc_unit = ptc::ordered_ptc(source, itemTransformer, readWriter, programParams.num_threads);
             ptc_unit->start();
             auto f = ptc_unit->get_future();
             stats = f.get();
         }
         else
         {
-            auto ptc_unit = ptc::unordered_ptc(readReader, transformer, readWriter, programParams.num_threads);
+            auto ptc_unit = ptc::unordered_ptc(source, itemTransformer, readWriter, programParams.num_threads);
             ptc_unit->start();
             auto f = ptc_unit->get_future();
             stats = f.get();
         }
+    };
+
+    TStats generalStats(length(demultiplexingParams.barcodeIds) + 1, adapterTrimmingParams.adapters.size());
+
+    if (programParams.num_threads > 1)
+    {
+        if (inputFileStreams.chunker1)
+            runPtc(chunkReader, chunkTransformer);
+        else
+            runPtc(readReader, transformer);
     }
     else
     {
-        std::unique_ptr<std::vector<TRead<TSeq>>> readSet;
+        auto readSet = std::make_unique<std::vector<TRead<TSeq>>>();    // reused for all batches
+        RawChunk chunk;
         const auto tMain = std::chrono::steady_clock::now();
-        while (generalStats.readCount < programParams.firstReads)
+        while (resumedReads + generalStats.readCount < programParams.firstReads)
         {
-            readSet.reset(new std::vector<TRead<TSeq>>(programParams.records));
             auto t1 = std::chrono::steady_clock::now();
-            const auto numReadsRead = readReads(*readSet, programParams.records, inputFileStreams);
+            unsigned int numReadsRead;
+            try
+            {
+                if (inputFileStreams.chunker1)
+                {
+                    const auto numRecords = readChunk(chunk, batchSizer.records(), inputFileStreams);
+                    batchSizer.update(batchBytes(chunk), numRecords);
+                    numReadsRead = parseChunk(*readSet, chunk);
+                }
+                else
+                {
+                    numReadsRead = readReads(*readSet, batchSizer.records(), inputFileStreams);
+                    batchSizer.update(batchSizer.budgeted() ? batchBytes(*readSet) : 0, numReadsRead);
+                }
+            }
+            catch (const std::exception& e)
+            {
+                inputFailed(e);
+                break;
+            }
             generalStats.ioTime += std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::steady_clock::now() - t1).count();
             if (numReadsRead == 0)
                 break;
@@ -427,7 +607,13 @@ int mainLoop(TRead<TSeq>, const ProgramParams& programParams, InputFileStreams&
             generalStats += std::get<2>(*res);
 
             t1 = std::chrono::steady_clock::now();
-            outputStreams.writeSeqs(std::move(*(std::get<0>(*res))), demultiplexingParams.barcodeIds);
+            outputStreams.writeSeqs(*std::get<0>(*res), demultiplexingParams.barcodeIds);
+            readSet = std::move(std::get<0>(*res));
+            if (checkpointer)
+            {
+                batchRead(generalStats.readCount);
+                checkpointer->batchWritten(generalStats, outputStreams);
+            }
             generalStats.ioTime += std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::steady_clock::now() - t1).count();
 
             // Print information
@@ -439,6 +625,11 @@ int mainLoop(TRead<TSeq>, const ProgramParams& programParams, InputFileStreams&
         }
         stats = generalStats;
     }
+    if (failed)
+    {
+        std::cerr << "\nError while reading the input: " << inputError << std::endl;
+        return 1;
+    }
     return 0;
 }
 
@@ -472,6 +663,20 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
 
     seqan::CharString output;
     getOptionValue(output, parser, "output");
+    seqan::CharString filename1;
+    getArgumentValue(filename1, parser, 0, 0);
+
+    // Reads are written to standard output if requested, or by default if they are read from standard input.
+    // All messages go to standard error then, the reads are written through the original buffer of std::cout.
+    const bool useStdout = output == "-" || (output == "" && filename1 == "-");
+    std::ostream stdoutStream(std::cout.rdbuf());
+    struct CoutRestorer     // std::cout gets its buffer back on every return
+    {
+        std::streambuf* const buffer;
+        ~CoutRestorer() { std::cout.rdbuf(buffer); }
+    } coutRestorer{std::cout.rdbuf()};
+    if (useStdout)
+        std::cout.rdbuf(std::cerr.rdbuf());
 
     //--------------------------------------------------
     // Parse pre- and postprocessing parameters.
@@ -600,6 +805,33 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
     InputFileStreams inputFileStreams;
     if (loadProgramParams(parser, programParams, inputFileStreams) != 0)
         return 1;
+    if (programParams.stdinInput && demultiplexingParams.runx)
+    {
+        std::cerr << "Reads from standard input can not be combined with a multiplex barcode file.\n";
+        return 1;
+    }
+    if (useStdout && demultiplexingParams.run)
+    {
+        std::cerr << "Demultiplexed reads can not be written to standard output.\n";
+        return 1;
+    }
+    if (programParams.shardCount > 1 && demultiplexingParams.runx)
+    {
+        std::cerr << "Sharding can not be combined with a multiplex barcode file.\n";
+        return 1;
+    }
+    if ((programParams.checkpointInterval != 0 || programParams.resume) && (demultiplexingParams.runx || useStdout))
+    {
+        std::cerr << "Checkpoints can not be combined with a multiplex barcode file or standard output.\n";
+        return 1;
+    }
+    if (inputFileStreams.chunker1 && demultiplexingParams.runx)
+    {
+        std::cout << "\nParallel parsing and memory mapping can not be combined with a multiplex barcode file, reads are parsed sequentially.\n";
+        inputFileStreams.chunker1.reset();
+        inputFileStreams.chunker2.reset();
+        programParams.parallelParsing = programParams.mmap = false;
+    }
 
     if (checkParams(programParams, inputFileStreams, processingParams, demultiplexingParams, adapterTrimmingParams, qualityTrimmingParams) != 0)
         return 1;
@@ -616,9 +848,6 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
         noQuality = true;
     }
 
-    seqan::CharString filename1;
-    getArgumentValue(filename1, parser, 0, 0);
-
     bool useDefault = false;
     if (output == "")
     {
@@ -626,7 +855,39 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
         useDefault = true;
     }
 
-    OutputStreams outputStreams(seqan::toCString(output), noQuality);
+    OutputStreams outputStreams(seqan::toCString(output), noQuality, programParams.num_threads, programParams.writerThreads, programParams.interleavedOutput);
+    if (useStdout)
+        outputStreams.openStdout(stdoutStream, noQuality);
+    if (programParams.shardCount > 1)
+        outputStreams.setBaseSuffix("_shard" + std::to_string(programParams.shardIndex + 1) + "of" + std::to_string(programParams.shardCount));
+
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (programParams.checkpointInterval != 0 || programParams.resume)
+    {
+        if (!outputStreams.truncatable())
+        {
+            std::cerr << "Checkpoints need uncompressed output files, or BGZF output with more than one thread.\n";
+            return 1;
+        }
+        const std::string checkpointFile = outputStreams.getBaseFilename() + "_flexcat_checkpoint.txt";
+        Checkpoint checkpoint;
+        if (programParams.resume)
+        {
+            if (!loadCheckpoint(checkpointFile, checkpoint))
+            {
+                std::cerr << "Could not read the checkpoint file " << checkpointFile << ".\n";
+                return 1;
+            }
+            if (!inputFileStreams.chunker1->seek(checkpoint.inputOffset1) ||
+                (inputFileStreams.chunker2 && !inputFileStreams.chunker2->seek(checkpoint.inputOffset2)))
+            {
+                std::cerr << "The checkpoint does not match the input files.\n";
+                return 1;
+            }
+            outputStreams.resume(checkpoint.outputs);
+        }
+        checkpointer = std::make_unique<Checkpointer>(checkpointFile, programParams.checkpointInterval, std::move(checkpoint));
+    }
 
     // Output additional Information on selected stages:
     if (!isSet(parser, "ni"))
@@ -657,7 +918,12 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
         }
         std:: cout << "\n"; 
         std::cout << "General Options:\n";
-        std::cout << "\tReads per block: " << programParams.records * ((programParams.fileCount == 2) + 1)<< "\n";
+        if (programParams.batchBytes != 0)
+            std::cout << "\tBytes per block: " << programParams.batchBytes << "\n";
+        if (programParams.adaptiveBatch)
+            std::cout << "\tAdaptive block size: YES" << std::endl;
+        if (programParams.records != std::numeric_limits<unsigned>::max())
+            std::cout << "\tReads per block: " << programParams.records * ((programParams.fileCount == 2 || programParams.interleavedInput) + 1)<< "\n";
         /*
         if (isSet(parser, "c"))
         {
@@ -687,6 +953,24 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
             std::cout << "\tOrder policy: ordered" << std::endl;
         else
             std::cout << "\tOrder policy: unordered" << std::endl;
+        if (programParams.parallelParsing)
+            std::cout << "\tParallel parsing: YES" << std::endl;
+        if (programParams.mmap)
+            std::cout << "\tMemory mapped input: YES" << std::endl;
+        if (programParams.interleavedInput)
+            std::cout << "\tInterleaved input: YES" << std::endl;
+        if (programParams.interleavedOutput)
+            std::cout << "\tInterleaved output: YES" << std::endl;
+        if (programParams.writerThreads > 1)
+            std::cout << "\tWriter threads: " << programParams.writerThreads << std::endl;
+        if (programParams.shardCount > 1)
+            std::cout << "\tShard: " << programParams.shardIndex + 1 << "/" << programParams.shardCount << std::endl;
+        if (isSet(parser, "sh") && isSet(parser, "mm"))
+            std::cout << "\tMemory mapped input: NO, shards are read through a stream buffer" << std::endl;
+        if (programParams.checkpointInterval != 0)
+            std::cout << "\tCheckpoint interval: " << programParams.checkpointInterval << " s" << std::endl;
+        if (checkpointer && programParams.resume)
+            std::cout << "\tResumed after reads: " << checkpointer->resumed().records << std::endl;
         if(flexiProgram == FlexiProgram::ADAPTER_REMOVAL || flexiProgram == FlexiProgram::QUALITY_CONTROL|| flexiProgram == FlexiProgram::ALL_STEPS)
         {
             if (isSet(parser, "t"))
@@ -775,7 +1059,7 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
             {
                 std::cout << "\tAdapter file: NONE\n";
             }
-            if (programParams.fileCount == 2)
+            if (programParams.fileCount == 2 || programParams.interleavedInput)
             {
                 if (adapterTrimmingParams.pairedNoAdapterFile)
                 {
@@ -836,30 +1120,41 @@ int flexcatMain(const FlexiProgram flexiProgram, int argc, char const ** argv)
     // Start processing. Different functions are needed for one or two input files.
     std::cout << "\nProcessing reads...\n" << std::endl;
     GeneralStats generalStats(length(demultiplexingParams.barcodeIds) + 1, adapterTrimmingParams.adapters.size());
+    int loopResult;
 
-    if (fileCount == 1)
+    if (fileCount == 1 && !programParams.interleavedInput)
     {
         if (!demultiplexingParams.run)
             outputStreams.addStream("", 0, useDefault);
         if(demultiplexingParams.runx)
-            mainLoop(ReadMultiplex<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats);
+            loopResult = mainLoop(ReadMultiplex<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats, checkpointer.get());
         else
-            mainLoop(Read<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats);
+            loopResult = mainLoop(Read<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats, checkpointer.get());
     }
      else
      {
-         if (!demultiplexingParams.run)
+         if (!demultiplexingParams.run && programParams.interleavedOutput)
+             outputStreams.addStream("", 0, useDefault);
+         else if (!demultiplexingParams.run)
              outputStreams.addStreams("", "", 0, useDefault);
          if (demultiplexingParams.runx)
-             mainLoop(ReadMultiplexPairedEnd<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats);
+             loopResult = mainLoop(ReadMultiplexPairedEnd<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats, checkpointer.get());
          else
-             mainLoop(ReadPairedEnd<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats);
+             loopResult = mainLoop(ReadPairedEnd<seqan::Dna5QString>(), programParams, inputFileStreams, demultiplexingParams, processingParams, adapterTrimmingParams, qualityTrimmingParams, esaFinder, outputStreams, generalStats, checkpointer.get());
+    }
+    if (loopResult != 0)    // the checkpoint file is kept, the run can be resumed from the last checkpoint
+        return loopResult;
+    if (checkpointer)
+    {
+        if (programParams.resume)
+            generalStats += checkpointer->resumed().stats;
+        std::remove(checkpointer->fileName().c_str());  // the run is complete, there is nothing left to resume
     }
     double loop = SEQAN_PROTIMEDIFF(loopTime);
     generalStats.processTime = loop - generalStats.ioTime;
 
     printStatistics(programParams, generalStats, demultiplexingParams, adapterTrimmingParams, !isSet(parser, "ni"), std::cout);
-    if (isSet(parser, "st"))
+    if (isSet(parser, "st") && !useStdout)  // with standard output the statistics above already went to standard error
     {
         std::fstream statFile;
 #ifdef _MSC_VER
@@ -34,8 +34,12 @@
 
 #pragma once
 
+#include <memory>
+
 #include <seqan/sequence.h>
 
+#include "read_reader.h"
+
 struct ProcessingParams
 {
     seqan::Dna substitute;
@@ -69,6 +73,9 @@ struct ProcessingParams
 struct InputFileStreams
 {
     seqan::SeqFileIn fileStream1, fileStream2, fileStreamMultiplex;
+    std::unique_ptr<FastqChunker> chunker1, chunker2;   // only used for parallel parsing
+    bool interleaved = false;    // both mates of each pair are read from fileStream1 (or chunker1)
+    std::unique_ptr<ptc::TaskPool> mateReader;    // reads the second mates while the first mates are read, created on first use
 };
 
 
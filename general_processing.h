@@ -86,7 +86,7 @@ constexpr void replaceN(TSeqChar& seqChar, const NoSubstitute) noexcept
 template<typename TSeq, typename TSub>
 inline int findNUniversal(TSeq& seq, unsigned allowed, const TSub substitute) noexcept
 {
-    const TSeq wanted = 'N';
+    const typename seqan::Value<TSeq>::Type wanted = 'N';
     unsigned c = 0;
     for (auto& seqChar : seq)
     {
@@ -6,9 +6,15 @@
 // ==========================================================================
 #pragma once
 
+#include <condition_variable>
 #include <future>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
 
 #include <boost/lockfree/queue.hpp>
 
@@ -494,17 +500,23 @@ namespace ptc
             {
                 std::list<std::unique_ptr<item_type>> itemBuffer;
                 std::unique_ptr<item_type> currentItemIdPair;
-                while (_run.load(std::memory_order_relaxed) || !itemBuffer.empty())
+                while (true)
                 {
+                    // read the flag before looking into the slots, so that items which were pushed before shutDown are not lost
+                    const bool run = _run.load(std::memory_order_acquire);
                     if(std::is_same<TOrderPolicy, OrderPolicy::Ordered>::value && !itemBuffer.empty())  // only in ordered mode
                     {
-                        for (auto it = itemBuffer.begin();it != itemBuffer.end();++it)
+                        auto it = itemBuffer.begin();
+                        while (it != itemBuffer.end())
                         {
                             if (this->is_next_item((*it).get()))
                             {
                                 _sink(std::move(this->extractItem(std::move(*it))));
-                                it = itemBuffer.erase(it);
+                                itemBuffer.erase(it);
+                                it = itemBuffer.begin();    // the following item might be located in front of this one
                             }
+                            else
+                                ++it;
                         }
                     }
                     if (_slots.try_retrieve(currentItemIdPair))
@@ -519,6 +531,11 @@ namespace ptc
                             itemBuffer.emplace_back(std::move(currentItemIdPair));
                         }
                     }
+                    else if (!run)
+                    {
+                        if (itemBuffer.empty())
+                            break;
+                    }
                     else if(std::is_same<TOrderPolicy, OrderPolicy::Unordered>::value || 
                         std::is_same<TOrderPolicy, OrderPolicy::Unordered_use_queue>::value || 
                         itemBuffer.empty())
@@ -533,7 +550,7 @@ namespace ptc
         }
         void shutDown()
         {
-            _run.store(false, std::memory_order_relaxed);
+            _run.store(false, std::memory_order_release);
             WaitManager<TWaitPolicy>::signal();
             if (_thread.joinable())
                 _thread.join();
@@ -629,4 +646,113 @@ namespace ptc
         return std::make_unique<PTC_unit<TSource, TTransformer, TSink, OrderPolicy::Unordered_use_queue, WaitPolicy::Semaphore>>
             (std::forward<TSource>(source), transformer, std::forward<TSink>(sink), numThreads);
     }
+
+    /*
+    Fixed number of threads that run submitted tasks in order of submission.
+    Meant for coarse tasks like (de)compressing a block, so a mutex is good enough here.
+    */
+    class TaskPool
+    {
+    private:
+        std::vector<std::thread> _threads;
+        std::queue<std::function<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _taskAvailable;
+        bool _stop;
+
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+    public:
+        TaskPool(const unsigned int numThreads) : _stop(false)
+        {
+            for (unsigned int i = 0; i < numThreads; ++i)
+            {
+                _threads.emplace_back([this]()
+                {
+                    while (true)
+                    {
+                        std::function<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock(_mutex);
+                            _taskAvailable.wait(lock, [this]() {return _stop || !_tasks.empty();});
+                            if (_tasks.empty())
+                                return;
+                            task = std::move(_tasks.front());
+                            _tasks.pop();
+                        }
+                        task();
+                    }
+                });
+            }
+        }
+        // remaining tasks are still executed
+        ~TaskPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _taskAvailable.notify_all();
+            for (auto& thread : _threads)
+                thread.join();
+        }
+
+        template <typename TFunc>
+        auto submit(TFunc func)
+        {
+            auto task = std::make_shared<std::packaged_task<std::result_of_t<TFunc()>()>>(std::move(func));
+            auto f = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _tasks.emplace([task]() {(*task)();});
+            }
+            _taskAvailable.notify_one();
+            return f;
+        }
+    };
+
+    /*
+    Keeps at most maxItems released items, so that get() can hand them out again instead of
+    allocating new ones. The items are not cleared, reusing their buffers is the whole point.
+    */
+    template <typename TItem>
+    class RecyclePool
+    {
+    private:
+        std::vector<std::unique_ptr<TItem>> _items;
+        std::mutex _mutex;
+        const std::size_t _maxItems;
+
+        RecyclePool(const RecyclePool&) = delete;
+        RecyclePool& operator=(const RecyclePool&) = delete;
+    public:
+        RecyclePool(const std::size_t maxItems) : _maxItems(maxItems)
+        {
+            _items.reserve(maxItems);
+        }
+
+        std::unique_ptr<TItem> get()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_items.empty())
+                {
+                    auto item = std::move(_items.back());
+                    _items.pop_back();
+                    return item;
+                }
+            }
+            return std::make_unique<TItem>();
+        }
+
+        // items beyond maxItems are destroyed
+        void release(std::unique_ptr<TItem> item)
+        {
+            if (!item)
+                return;
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_items.size() < _maxItems)
+                _items.push_back(std::move(item));
+        }
+    };
 }
@@ -48,18 +48,16 @@ struct ReadBase
     ReadBase() = default;
     ReadBase(const ReadBase& rhs) = default;
     ReadBase(ReadBase&& rhs) noexcept(std::is_nothrow_move_constructible<TSeq>::value)
-    {
-        seq = std::move(rhs.seq);
-        id = std::move(rhs.id);
-        demuxResult = rhs.demuxResult;
-    }
+        : seq(std::move(rhs.seq)), id(std::move(rhs.id)), demuxResult(rhs.demuxResult)
+    {}
 
     bool operator==(const ReadBase& rhs) const
     {
         return seq == rhs.seq && id == rhs.id && demuxResult == rhs.demuxResult;
     }
     ReadBase& operator=(const ReadBase& rhs) = default;
-    ReadBase& operator=(const ReadBase&& rhs) noexcept(std::is_nothrow_move_assignable<TSeq>::value)
+    // rhs must not be const, otherwise the members would be copied instead of moved
+    ReadBase& operator=(ReadBase&& rhs) noexcept(std::is_nothrow_move_assignable<TSeq>::value)
     {
         seq = std::move(rhs.seq);
         id = std::move(rhs.id);
@@ -101,17 +99,15 @@ struct ReadMultiplex : ReadBase<TSeq>
     ReadMultiplex() = default;
     ReadMultiplex(const ReadMultiplex& rhs) = default;
     ReadMultiplex(ReadMultiplex&& rhs) noexcept(std::is_nothrow_move_constructible<TSeq>::value)
-        : ReadBase<TSeq>(std::move(rhs))
-    {
-        demultiplex = std::move(rhs.demultiplex);
-    }
+        : ReadBase<TSeq>(std::move(rhs)), demultiplex(std::move(rhs.demultiplex))
+    {}
 
     bool operator==(const ReadMultiplex& rhs) const
     {
         return ReadBase<TSeq>::operator==(rhs) && demultiplex == rhs.demultiplex;
     }
     ReadMultiplex& operator=(const ReadMultiplex& rhs) = default;
-    ReadMultiplex& operator=(const ReadMultiplex&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
+    ReadMultiplex& operator=(ReadMultiplex&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
     {
         ReadBase<TSeq>::operator=(std::move(rhs));
         demultiplex = std::move(rhs.demultiplex);
@@ -128,18 +124,15 @@ struct ReadPairedEnd : ReadBase<TSeq>
     ReadPairedEnd() = default;
     ReadPairedEnd(const ReadPairedEnd& rhs) = default;
     ReadPairedEnd(ReadPairedEnd&& rhs) noexcept(std::is_nothrow_move_constructible<TSeq>::value)
-        : ReadBase<TSeq>(std::move(rhs))
-    {
-        seqRev = std::move(rhs.seqRev);
-        idRev = std::move(rhs.idRev);
-    }
+        : ReadBase<TSeq>(std::move(rhs)), seqRev(std::move(rhs.seqRev)), idRev(std::move(rhs.idRev))
+    {}
 
     bool operator==(const ReadPairedEnd& rhs) const
     {
         return ReadBase<TSeq>::operator==(rhs) && seqRev == rhs.seqRev && idRev == rhs.idRev;
     }
     ReadPairedEnd& operator=(const ReadPairedEnd& rhs) = default;
-    ReadPairedEnd& operator=(const ReadPairedEnd&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
+    ReadPairedEnd& operator=(ReadPairedEnd&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
     {
         ReadBase<TSeq>::operator=(std::move(rhs));
         seqRev = std::move(rhs.seqRev);
@@ -160,17 +153,15 @@ struct ReadMultiplexPairedEnd : ReadPairedEnd<TSeq>
     ReadMultiplexPairedEnd() = default;
     ReadMultiplexPairedEnd(const ReadMultiplexPairedEnd& rhs) = default;
     ReadMultiplexPairedEnd(ReadMultiplexPairedEnd&& rhs) noexcept(std::is_nothrow_move_constructible<TSeq>::value)
-        : ReadPairedEnd<TSeq>(std::move(rhs))
-    {
-        demultiplex = std::move(rhs.demultiplex);
-    }
+        : ReadPairedEnd<TSeq>(std::move(rhs)), demultiplex(std::move(rhs.demultiplex))
+    {}
 
     bool operator==(const ReadMultiplexPairedEnd& rhs) const
     {
         return ReadPairedEnd<TSeq>::operator==(rhs) && demultiplex == rhs.demultiplex;
     }
     ReadMultiplexPairedEnd& operator=(const ReadMultiplexPairedEnd& rhs) = default;
-    ReadMultiplexPairedEnd& operator=(const ReadMultiplexPairedEnd&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
+    ReadMultiplexPairedEnd& operator=(ReadMultiplexPairedEnd&& rhs)  noexcept(std::is_nothrow_move_assignable<TSeq>::value)
     {
         ReadPairedEnd<TSeq>::operator=(std::move(rhs));
         demultiplex = std::move(rhs.demultiplex);
@@ -0,0 +1,1077 @@
+// ==========================================================================
+//                               read_reader.h
+// ==========================================================================
+// Copyright (c) 2006-2015, Knut Reinert, FU Berlin
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Knut Reinert or the FU Berlin nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL KNUT REINERT OR THE FU BERLIN BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// ==========================================================================
+// Author: Benjamin Menkuec <benjamin@menkuec.de>
+// ==========================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <seqan/sequence.h>
+
+#include "read.h"
+#include "bgzf.h"
+#include "ptc.h"
+
+// ============================================================================
+// Input sources
+// ============================================================================
+
+inline bool _seek(std::FILE* file, const std::uint64_t offset) noexcept
+{
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Provides the raw bytes of an input file.
+class InputSource
+{
+public:
+    virtual ~InputSource() {};
+
+    // Reads up to len bytes into buffer. Returns the number of bytes read, 0 means end of input.
+    virtual std::size_t read(char* buffer, const std::size_t len) = 0;
+
+    // Continues reading at offset of the file. Returns false if the source can not seek.
+    virtual bool seek(const std::uint64_t /*offset*/)
+    {
+        return false;
+    }
+};
+
+class FileInputSource : public InputSource
+{
+    std::FILE* _file;
+    const bool _close;
+
+    FileInputSource(const FileInputSource&) = delete;
+    FileInputSource& operator=(const FileInputSource&) = delete;
+public:
+    FileInputSource(std::FILE* file, const bool close = true) : _file(file), _close(close) {};
+    ~FileInputSource()
+    {
+        if (_file != nullptr && _close)
+            std::fclose(_file);
+    }
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        return std::fread(buffer, 1, len, _file);
+    }
+    bool seek(const std::uint64_t offset) override
+    {
+        return _seek(_file, offset);
+    }
+};
+
+// Returns bytes that have already been read from source (e.g. to check the file type) before the rest of source.
+class PrefixedInputSource : public InputSource
+{
+    std::string _prefix;
+    std::size_t _prefixPos;
+    std::unique_ptr<InputSource> _source;
+public:
+    PrefixedInputSource(std::string prefix, std::unique_ptr<InputSource> source)
+        : _prefix(std::move(prefix)), _prefixPos(0), _source(std::move(source)) {};
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        const auto n = std::min(len, _prefix.size() - _prefixPos);
+        std::memcpy(buffer, _prefix.data() + _prefixPos, n);
+        _prefixPos += n;
+        return n == len ? n : n + _source->read(buffer + n, len - n);
+    }
+};
+
+// checks for the gzip magic bytes without consuming them
+inline bool isCompressed(std::FILE* file) noexcept
+{
+    unsigned char magic[2] = { 0, 0 };
+    const auto numRead = std::fread(magic, 1, 2, file);
+    std::rewind(file);
+    return numRead == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+inline bool isCompressed(const char* fileName) noexcept
+{
+    std::FILE* file = std::fopen(fileName, "rb");
+    if (file == nullptr)
+        return false;
+    const bool compressed = isCompressed(file);
+    std::fclose(file);
+    return compressed;
+}
+
+#if SEQAN_HAS_ZLIB
+// Inflates a gzip file in a separate thread, so that decompression and record splitting overlap.
+// Files consisting of multiple gzip members are supported.
+class GzipInputSource : public InputSource
+{
+    std::unique_ptr<InputSource> _source;   // compressed data
+    std::deque<std::vector<char>> _buffers;     // inflated data, not yet read
+    std::vector<char> _current;
+    std::size_t _currentPos;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    bool _done;
+    bool _stop;
+    std::string _error;
+    std::thread _thread;
+
+    static constexpr std::size_t bufferSize = 1 << 20;
+    static constexpr unsigned int maxBuffers = 4;
+
+    GzipInputSource(const GzipInputSource&) = delete;
+    GzipInputSource& operator=(const GzipInputSource&) = delete;
+
+    void _inflate()
+    {
+        z_stream stream = z_stream();
+        std::vector<unsigned char> in(bufferSize);
+        bool inMember = false;
+        if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK)   // gzip header
+            _error = "Could not initialize zlib.";
+        while (_error.empty())
+        {
+            std::vector<char> out(bufferSize);
+            stream.next_out = reinterpret_cast<Bytef*>(out.data());
+            stream.avail_out = static_cast<uInt>(out.size());
+            while (stream.avail_out != 0)
+            {
+                if (stream.avail_in == 0)
+                {
+                    stream.avail_in = static_cast<uInt>(_source->read(reinterpret_cast<char*>(in.data()), in.size()));
+                    stream.next_in = in.data();
+                    if (stream.avail_in == 0)
+                        break;
+                }
+                inMember = true;
+                const int ret = inflate(&stream, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END)
+                {
+                    inMember = false;
+                    inflateReset(&stream);  // another member might follow
+                }
+                else if (ret != Z_OK && ret != Z_BUF_ERROR)
+                {
+                    _error = "Corrupt gzip input.";
+                    break;
+                }
+            }
+            const bool atEnd = stream.avail_out != 0;
+            out.resize(out.size() - stream.avail_out);
+            if (atEnd && inMember && _error.empty())
+                _error = "Truncated gzip input.";
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _changed.wait(lock, [this]() {return _stop || _buffers.size() < maxBuffers;});
+            if (_stop)
+                break;
+            if (!out.empty())
+                _buffers.push_back(std::move(out));
+            if (atEnd)
+                break;
+            _changed.notify_all();
+        }
+        inflateEnd(&stream);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+        _changed.notify_all();
+    }
+
+public:
+    GzipInputSource(std::unique_ptr<InputSource> source) : _source(std::move(source)), _currentPos(0), _done(false), _stop(false)
+    {
+        _thread = std::thread([this]() {_inflate();});
+    }
+    GzipInputSource(std::FILE* file) : GzipInputSource(std::make_unique<FileInputSource>(file)) {};
+    ~GzipInputSource()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _changed.notify_all();
+        _thread.join();
+    }
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        std::size_t numRead = 0;
+        while (numRead < len)
+        {
+            if (_currentPos == _current.size())
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _changed.wait(lock, [this]() {return _done || !_buffers.empty();});
+                if (_buffers.empty())
+                {
+                    if (!_error.empty())
+                        throw std::runtime_error(_error);
+                    break;
+                }
+                _current = std::move(_buffers.front());
+                _buffers.pop_front();
+                _currentPos = 0;
+                _changed.notify_all();
+            }
+            const auto n = std::min(len - numRead, _current.size() - _currentPos);
+            std::memcpy(buffer + numRead, _current.data() + _currentPos, n);
+            numRead += n;
+            _currentPos += n;
+        }
+        return numRead;
+    }
+};
+
+// Decompresses the blocks of a BGZF file in parallel. The blocks are read sequentially
+// and inflated by a pool of threads, while read() hands out the results in file order.
+class BgzfInputSource : public InputSource
+{
+    std::FILE* _file;
+    ptc::TaskPool _pool;
+    std::deque<std::future<std::vector<char>>> _blocks;    // blocks that are being inflated, in file order
+    std::vector<char> _current;
+    std::size_t _currentPos;
+    bool _eof;
+    const std::size_t _maxPending;
+
+    BgzfInputSource(const BgzfInputSource&) = delete;
+    BgzfInputSource& operator=(const BgzfInputSource&) = delete;
+
+    void _submitBlocks()
+    {
+        while (!_eof && _blocks.size() < _maxPending)
+        {
+            std::vector<unsigned char> block;
+            if (!readBgzfBlock(_file, block))
+            {
+                _eof = true;
+                return;
+            }
+            _blocks.push_back(_pool.submit([block = std::move(block)]() {return inflateBgzfBlock(block);}));
+        }
+    }
+
+public:
+    BgzfInputSource(std::FILE* file, const unsigned int numThreads)
+        : _file(file), _pool(numThreads), _currentPos(0), _eof(false), _maxPending(4 * numThreads) {};
+    ~BgzfInputSource()
+    {
+        std::fclose(_file);
+    }
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        std::size_t numRead = 0;
+        while (numRead < len)
+        {
+            if (_currentPos == _current.size())
+            {
+                _submitBlocks();
+                if (_blocks.empty())
+                    break;
+                _current = _blocks.front().get();
+                _blocks.pop_front();
+                _currentPos = 0;
+                continue;
+            }
+            const auto n = std::min(len - numRead, _current.size() - _currentPos);
+            std::memcpy(buffer + numRead, _current.data() + _currentPos, n);
+            numRead += n;
+            _currentPos += n;
+        }
+        _submitBlocks();    // keep the pool busy while the caller works on the data
+        return numRead;
+    }
+};
+#endif  // SEQAN_HAS_ZLIB
+
+// Standard input can not be rewound, so the bytes that were read to check for gzip are put in front again.
+// Returns nullptr for compressed input without zlib support.
+inline std::unique_ptr<InputSource> openStdinSource()
+{
+    auto source = std::make_unique<FileInputSource>(stdin, false);
+    char magic[2];
+    const auto numRead = source->read(magic, sizeof(magic));
+    auto prefixed = std::make_unique<PrefixedInputSource>(std::string(magic, numRead), std::move(source));
+    if (numRead != 2 || static_cast<unsigned char>(magic[0]) != 0x1f || static_cast<unsigned char>(magic[1]) != 0x8b)
+        return std::move(prefixed);
+#if SEQAN_HAS_ZLIB
+    return std::make_unique<GzipInputSource>(std::move(prefixed));  // BGZF is valid gzip as well
+#else
+    return nullptr;
+#endif
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+    const char* _data;
+    std::size_t _size;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+public:
+    MappedFile() : _data(nullptr), _size(0) {};
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (_data != nullptr)
+            munmap(const_cast<char*>(_data), _size);
+#endif
+    }
+
+    // Returns false if the file could not be mapped.
+    bool open(const char* fileName) noexcept
+    {
+#ifndef _WIN32
+        const int fd = ::open(fileName, O_RDONLY);
+        if (fd == -1)
+            return false;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+        _size = fileStat.st_size;
+        if (_size != 0)
+        {
+            void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(fd);
+                _size = 0;
+                return false;
+            }
+            madvise(data, _size, MADV_SEQUENTIAL);
+            _data = static_cast<const char*>(data);
+        }
+        ::close(fd);    // the mapping stays valid
+        return true;
+#else
+        (void)fileName;
+        return false;
+#endif
+    }
+    inline const char* begin() const noexcept
+    {
+        return _data;
+    }
+    inline const char* end() const noexcept
+    {
+        return _data + _size;
+    }
+    inline bool isCompressed() const noexcept
+    {
+        return _size >= 2 && static_cast<unsigned char>(_data[0]) == 0x1f && static_cast<unsigned char>(_data[1]) == 0x8b;
+    }
+};
+
+// ============================================================================
+// Record chunking
+// ============================================================================
+
+enum class RecordFormat
+{
+    fastq,
+    fasta
+};
+
+// A block of complete records, as they are stored in the input file.
+// [first, last) either points into data or, for mapped files, directly into the mapping.
+struct RawBlock
+{
+    std::vector<char> data;
+    const char* first;
+    const char* last;
+    unsigned int records;
+    RecordFormat format;
+
+    RawBlock() : first(nullptr), last(nullptr), records(0), format(RecordFormat::fastq) {};
+    RawBlock(const RawBlock&) = delete;
+    RawBlock& operator=(const RawBlock&) = delete;
+};
+
+// One batch of raw input, block2 holds the mates in paired-end mode.
+// Interleaved paired-end input has both mates of each pair in block1, one after the other.
+struct RawChunk
+{
+    RawBlock block1;
+    RawBlock block2;
+    bool interleaved;
+
+    RawChunk() : interleaved(false) {};
+};
+
+inline bool _isWhitespace(const char* first, const char* last) noexcept
+{
+    return std::all_of(first, last, [](const char c) {return c == '\n' || c == '\r' || c == ' ' || c == '\t';});
+}
+
+// Returns the end of the last complete record in [first, last) and sets records to the number
+// of complete records, but at most maxRecords. first has to be the begin of a record.
+// At the end of the input, an unterminated last line still completes the record.
+inline const char* _findRecords(const char* first, const char* last, const unsigned int maxRecords, const bool atEof,
+    const RecordFormat format, unsigned int& records)
+{
+    records = 0;
+    const char* recordEnd = first;
+    const char* it = first;
+    if (format == RecordFormat::fastq)
+    {
+        unsigned int lines = 0;
+        while (records < maxRecords && it != last)
+        {
+            const auto lineEnd = static_cast<const char*>(std::memchr(it, '\n', last - it));
+            if (lineEnd == nullptr && !atEof)
+                break;
+            it = lineEnd != nullptr ? lineEnd + 1 : last;
+            if (++lines == 4)
+            {
+                lines = 0;
+                ++records;
+                recordEnd = it;
+            }
+        }
+        if (atEof && records < maxRecords && !_isWhitespace(recordEnd, last))
+            throw std::runtime_error("Input ends with an incomplete FASTQ record.");
+    }
+    else
+    {
+        // a record ends in front of the next line that starts with '>'
+        if (it != last)
+            ++it;
+        while (records < maxRecords && it != last)
+        {
+            const auto lineEnd = static_cast<const char*>(std::memchr(it, '\n', last - it));
+            it = lineEnd != nullptr ? lineEnd + 1 : last;
+            if (it != last && *it == '>')
+            {
+                ++records;
+                recordEnd = it;
+                ++it;
+            }
+        }
+        if (atEof && it == last && records < maxRecords && !_isWhitespace(recordEnd, last))
+        {
+            ++records;
+            recordEnd = last;
+        }
+    }
+    return recordEnd;
+}
+
+// Splits the input into blocks of complete records. Only the line breaks are
+// looked at, so this is a lot cheaper than parsing the records.
+// FASTQ records are expected to consist of exactly four lines.
+class FastqChunker
+{
+    std::unique_ptr<InputSource> _source;
+    std::unique_ptr<MappedFile> _mapping;
+    const char* _pos;               // current position in the mapping
+    std::vector<char> _carry;       // begin of the first incomplete record
+    std::size_t _bytesPerRecord;
+    bool _eof;
+    const RecordFormat _format;
+    std::uint64_t _offset;          // input offset of the first record that has not been returned yet
+
+    static constexpr std::size_t minReadSize = 1 << 16;
+
+    bool _fillBuffer(std::vector<char>& data, const std::size_t len)
+    {
+        const auto oldSize = data.size();
+        data.resize(oldSize + len);
+        const auto numRead = _source->read(data.data() + oldSize, len);
+        data.resize(oldSize + numRead);
+        if (numRead == 0)
+            _eof = true;
+        return numRead != 0;
+    }
+
+    // the records are not copied, the block points into the mapping
+    unsigned int _readMappedBlock(RawBlock& block, const unsigned int records)
+    {
+        block.data.clear();
+        block.first = _pos;
+        block.last = _findRecords(_pos, _mapping->end(), records, true, _format, block.records);
+        _pos = block.records < records ? _mapping->end() : block.last;
+        _eof = _pos == _mapping->end();
+        _offset += block.last - block.first;
+        return block.records;
+    }
+
+public:
+    // offset is the position of source in the input file, for sources that do not start at its begin
+    FastqChunker(std::unique_ptr<InputSource> source, const RecordFormat format = RecordFormat::fastq, const std::uint64_t offset = 0)
+        : _source(std::move(source)), _pos(nullptr), _bytesPerRecord(512), _eof(false), _format(format), _offset(offset) {};
+    FastqChunker(std::unique_ptr<MappedFile> mapping, const RecordFormat format = RecordFormat::fastq)
+        : _mapping(std::move(mapping)), _pos(_mapping->begin()), _bytesPerRecord(0), _eof(false), _format(format), _offset(0) {};
+
+    inline bool atEnd() const noexcept
+    {
+        return _eof && _carry.empty();
+    }
+
+    inline bool isMapped() const noexcept
+    {
+        return _mapping != nullptr;
+    }
+
+    // Only meaningful for uncompressed input.
+    inline std::uint64_t offset() const noexcept
+    {
+        return _offset;
+    }
+
+    // Continues at offset, which has to be a record start. Returns false if the input can not seek.
+    bool seek(const std::uint64_t offset)
+    {
+        if (_mapping)
+        {
+            if (offset > static_cast<std::uint64_t>(_mapping->end() - _mapping->begin()))
+                return false;
+            _pos = _mapping->begin() + offset;
+            _eof = _pos == _mapping->end();
+        }
+        else
+        {
+            if (!_source->seek(offset))
+                return false;
+            _eof = false;
+        }
+        _carry.clear();
+        _offset = offset;
+        return true;
+    }
+
+    // Reads at most records complete records into block. Returns the number of records.
+    unsigned int readBlock(RawBlock& block, const unsigned int records)
+    {
+        block.format = _format;
+        if (_mapping)
+            return _readMappedBlock(block, records);
+
+        auto& data = block.data;
+        data.assign(_carry.begin(), _carry.end());
+        _carry.clear();
+        const char* recordEnd;
+        while (true)
+        {
+            recordEnd = _findRecords(data.data(), data.data() + data.size(), records, _eof, _format, block.records);
+            if (block.records == records || _eof)
+                break;
+            _fillBuffer(data, std::max(static_cast<std::size_t>(minReadSize), (records - block.records) * _bytesPerRecord));
+        }
+        const std::size_t blockSize = recordEnd - data.data();
+        _carry.assign(data.begin() + blockSize, data.end());
+        data.resize(blockSize);
+        block.first = data.data();
+        block.last = data.data() + blockSize;
+        if (block.records != 0)
+            _bytesPerRecord = blockSize / block.records + 1;
+        _offset += blockSize;
+        return block.records;
+    }
+};
+
+// ============================================================================
+// Batch sizing
+// ============================================================================
+
+// Chooses the number of records per batch, so that a batch holds about maxBytes bytes of input.
+// The size of a record is taken from the previous batch, the first batch is kept small to measure it.
+// Without a byte budget (maxBytes == 0), every batch has maxRecords records.
+//
+// In adaptive mode, the number of records is tuned at runtime instead. The throughput of the
+// pipeline is measured at the reader, which is slowed down by full queues just like every other
+// stage. Each measurement window covers enough batches to pass through the whole pipeline. The
+// batch size keeps moving in the same direction as long as the throughput does not drop.
+class BatchSizer
+{
+    const unsigned int _maxRecords;
+    const std::size_t _maxBytes;
+    std::size_t _bytesPerRecord;    // 0 until the first batch has been read
+
+    const bool _adaptive;
+    const unsigned int _windowBatches;
+    unsigned int _records;
+    unsigned int _batches;
+    std::size_t _windowRecords;
+    std::chrono::steady_clock::time_point _windowStart;
+    double _lastRate;
+    bool _grow;
+
+    static constexpr unsigned int minAdaptiveRecords = 16;
+    static constexpr unsigned int maxAdaptiveRecords = 1 << 18;
+
+    void _adapt(const unsigned int records)
+    {
+        _windowRecords += records;
+        if (++_batches < _windowBatches)
+            return;
+        const auto now = std::chrono::steady_clock::now();
+        const auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(now - _windowStart).count();
+        if (seconds < 0.2)
+            return;     // too short to be measured reliably
+        const double rate = _windowRecords / seconds;
+        if (rate < 0.98 * _lastRate)
+            _grow = !_grow;     // got slower, turn around
+        _lastRate = rate;
+        const unsigned int next = _grow ? _records + _records / 4 + 1 : _records - _records / 5;
+        _records = std::max(static_cast<unsigned int>(minAdaptiveRecords), std::min(static_cast<unsigned int>(maxAdaptiveRecords), next));
+        _batches = 0;
+        _windowRecords = 0;
+        _windowStart = now;
+    }
+
+public:
+    BatchSizer(const unsigned int maxRecords, const std::size_t maxBytes, const bool adaptive = false, const unsigned int windowBatches = 1)
+        : _maxRecords(maxRecords), _maxBytes(maxBytes), _bytesPerRecord(0), _adaptive(adaptive), _windowBatches(windowBatches),
+        _records(std::min(maxRecords, static_cast<unsigned int>(maxAdaptiveRecords))), _batches(0), _windowRecords(0),
+        _windowStart(std::chrono::steady_clock::now()), _lastRate(0), _grow(true) {};
+
+    inline bool budgeted() const noexcept
+    {
+        return _maxBytes != 0;
+    }
+
+    unsigned int records() const noexcept
+    {
+        const std::size_t firstBatchRecords = 64;
+        if (_adaptive)
+            return _records;
+        if (!budgeted())
+            return _maxRecords;
+        const std::size_t records = _bytesPerRecord == 0 ? firstBatchRecords : _maxBytes / _bytesPerRecord;
+        return static_cast<unsigned int>(std::max<std::size_t>(1, std::min<std::size_t>(_maxRecords, records)));
+    }
+
+    // bytes is only used with a byte budget
+    void update(const std::size_t bytes, const unsigned int records) noexcept
+    {
+        if (budgeted() && records != 0)
+            _bytesPerRecord = std::max<std::size_t>(1, bytes / records);
+        if (_adaptive)
+            _adapt(records);
+    }
+};
+
+// input bytes of a read, the sequence is counted twice for the qualities
+template <typename TSeq>
+inline std::size_t recordBytes(const ReadBase<TSeq>& read) noexcept
+{
+    return read.id.size() + 2 * length(read.seq);
+}
+
+template <typename TSeq>
+inline std::size_t recordBytes(const ReadPairedEnd<TSeq>& read) noexcept
+{
+    return read.id.size() + read.idRev.size() + 2 * (length(read.seq) + length(read.seqRev));
+}
+
+template <typename TRead>
+inline std::size_t batchBytes(const std::vector<TRead>& reads) noexcept
+{
+    std::size_t bytes = 0;
+    for (const auto& read : reads)
+        bytes += recordBytes(read);
+    return bytes;
+}
+
+inline std::size_t batchBytes(const RawChunk& chunk) noexcept
+{
+    return (chunk.block1.last - chunk.block1.first) + (chunk.block2.last - chunk.block2.first);
+}
+
+// ============================================================================
+// Record parsing
+// ============================================================================
+
+// Returns the line starting at it without the line break and moves it to the next line.
+inline void _getLine(const char*& it, const char* end, const char*& first, const char*& last) noexcept
+{
+    first = it;
+    const auto lineEnd = static_cast<const char*>(std::memchr(it, '\n', end - it));
+    last = lineEnd != nullptr ? lineEnd : end;
+    it = lineEnd != nullptr ? lineEnd + 1 : end;
+    if (last != first && *(last - 1) == '\r')
+        --last;
+}
+
+// Mates have the same name up to the first whitespace, apart from an optional /1 or /2 suffix.
+// The comment behind the whitespace may differ, e.g. the Casava read numbers in "1:N:0" and "2:N:0".
+inline std::size_t _mateNameLength(const std::string& id) noexcept
+{
+    auto len = id.find_first_of(" \t");
+    if (len == std::string::npos)
+        len = id.size();
+    if (len >= 2 && id[len - 2] == '/' && (id[len - 1] == '1' || id[len - 1] == '2'))
+        len -= 2;
+    return len;
+}
+
+inline bool _sameMateName(const std::string& id, const std::string& idRev) noexcept
+{
+    const auto len = _mateNameLength(id);
+    return len == _mateNameLength(idRev) && id.compare(0, len, idRev, 0, len) == 0;
+}
+
+inline void checkMateIds(const std::string& id, const std::string& idRev)
+{
+    if (!_sameMateName(id, idRev))
+        throw std::runtime_error("Paired-end input files are out of sync: read '" + id + "' is paired with '" + idRev + "'.");
+}
+
+template <typename TSeq>
+void _parseRecord(std::string& id, TSeq& seq, const char*& it, const char* end, const RecordFormat format)
+{
+    const char *first, *last, *seqFirst, *seqLast;
+    _getLine(it, end, first, last);
+    if (format == RecordFormat::fasta)
+    {
+        if (first == last || *first != '>')
+            throw std::runtime_error("FASTA record does not start with '>'.");
+        id.assign(first + 1, last);
+        // the sequence might span multiple lines
+        const char* recordEnd = it;
+        std::size_t len = 0;
+        while (recordEnd != end && *recordEnd != '>')
+        {
+            _getLine(recordEnd, end, first, last);
+            len += last - first;
+        }
+        seqan::resize(seq, len);
+        std::size_t i = 0;
+        while (it != recordEnd)
+        {
+            _getLine(it, end, first, last);
+            for (; first != last; ++first, ++i)
+                seq[i] = *first;
+        }
+        return;
+    }
+    if (first == last || *first != '@')
+        throw std::runtime_error("FASTQ record does not start with '@'.");
+    id.assign(first + 1, last);
+    _getLine(it, end, seqFirst, seqLast);
+    _getLine(it, end, first, last);
+    if (first == last || *first != '+')
+        throw std::runtime_error("FASTQ record has no '+' separator line.");
+    _getLine(it, end, first, last);
+    const auto len = seqLast - seqFirst;
+    if (last - first != len)
+        throw std::runtime_error("FASTQ record has different sequence and quality lengths.");
+    seqan::resize(seq, len);
+    for (std::ptrdiff_t i = 0; i < len; ++i)
+    {
+        seq[i] = seqFirst[i];
+        seqan::assignQualityValue(seq[i], first[i] - '!');
+    }
+}
+
+template < template<typename> class TRead, typename TSeq, typename = std::enable_if_t<std::is_same<TRead<TSeq>, Read<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplex<TSeq>>::value> >
+unsigned int parseChunk(std::vector<TRead<TSeq>>& reads, const RawChunk& chunk, bool = false)
+{
+    reads.resize(chunk.block1.records);
+    const char* it = chunk.block1.first;
+    for (auto& read : reads)
+        _parseRecord(read.id, read.seq, it, chunk.block1.last, chunk.block1.format);
+    return reads.size();
+}
+
+template < template<typename> class TRead, typename TSeq, typename = std::enable_if_t<std::is_same<TRead<TSeq>, ReadPairedEnd<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplexPairedEnd<TSeq>>::value> >
+unsigned int parseChunk(std::vector<TRead<TSeq>>& reads, const RawChunk& chunk)
+{
+    if (chunk.interleaved)
+    {
+        if (chunk.block1.records % 2 != 0)
+            throw std::runtime_error("Interleaved input ends with a read without mate.");
+        reads.resize(chunk.block1.records / 2);
+        const char* it = chunk.block1.first;
+        for (auto& read : reads)
+        {
+            _parseRecord(read.id, read.seq, it, chunk.block1.last, chunk.block1.format);
+            _parseRecord(read.idRev, read.seqRev, it, chunk.block1.last, chunk.block1.format);
+            checkMateIds(read.id, read.idRev);
+        }
+        return reads.size();
+    }
+    if (chunk.block1.records != chunk.block2.records)
+        throw std::runtime_error("Paired-end input files contain a different number of records.");
+    reads.resize(chunk.block1.records);
+    const char* it = chunk.block1.first;
+    const char* itRev = chunk.block2.first;
+    for (auto& read : reads)
+    {
+        _parseRecord(read.id, read.seq, it, chunk.block1.last, chunk.block1.format);
+        _parseRecord(read.idRev, read.seqRev, itRev, chunk.block2.last, chunk.block2.format);
+        checkMateIds(read.id, read.idRev);
+    }
+    return reads.size();
+}
+
+// ============================================================================
+// Sharding
+// ============================================================================
+
+// Shard i of n holds the records that start in the byte range [i * size / n, (i + 1) * size / n)
+// of the (first) input file. The range borders are moved forward to the next record start, so
+// every record belongs to exactly one shard. Only uncompressed files can be sharded.
+
+inline std::uint64_t fileSize(std::FILE* file)
+{
+    if (std::fseek(file, 0, SEEK_END) != 0)
+        throw std::runtime_error("Can not determine the size of the input file.");
+#ifdef _WIN32
+    const auto size = _ftelli64(file);
+#else
+    const auto size = ftello(file);
+#endif
+    std::rewind(file);
+    return static_cast<std::uint64_t>(size);
+}
+
+// Returns the offsets of the line starts in [offset, offset + window), together with the first character of each line.
+inline void _lineStarts(std::FILE* file, const std::uint64_t offset, const std::size_t window, std::vector<std::uint64_t>& starts, std::vector<char>& firstChars)
+{
+    starts.clear();
+    firstChars.clear();
+    std::vector<char> buffer(window + 1);
+    const std::uint64_t bufferOffset = offset == 0 ? 0 : offset - 1;  // the character in front tells if offset is a line start
+    if (!_seek(file, bufferOffset))
+        throw std::runtime_error("Can not seek in the input file.");
+    const auto numRead = std::fread(buffer.data(), 1, buffer.size(), file);
+    for (std::size_t i = 0; i < numRead; ++i)
+    {
+        const bool lineStart = bufferOffset + i == 0 || (i != 0 && buffer[i - 1] == '\n');
+        if (lineStart && bufferOffset + i >= offset)
+        {
+            starts.push_back(bufferOffset + i);
+            firstChars.push_back(buffer[i]);
+        }
+    }
+}
+
+// Returns the first record start at or after offset, or size if there is none.
+// A FASTQ record starts at a line beginning with '@', if the line after the next begins with '+'.
+// A quality line can begin with '@' as well, but then the line after the next is a sequence.
+// With pairs, the record has to be the first mate of an interleaved pair.
+inline std::uint64_t nextRecordStart(std::FILE* file, const std::uint64_t offset, const std::uint64_t size, const RecordFormat format, const bool pairs)
+{
+    if (offset == 0 || offset >= size)
+        return std::min(offset, size);
+    std::vector<std::uint64_t> starts;
+    std::vector<char> firstChars;
+    for (std::size_t window = 1 << 16; ; window *= 2)
+    {
+        _lineStarts(file, offset, window, starts, firstChars);
+        const bool complete = offset + window >= size;  // the window reaches the end of the file
+        for (std::size_t i = 0; i < starts.size(); ++i)
+        {
+            if (format == RecordFormat::fasta)
+            {
+                if (firstChars[i] == '>')
+                    return starts[i];
+                continue;
+            }
+            if (i + (pairs ? 5 : 2) >= starts.size())
+                break;      // not enough lines in the window to decide
+            if (firstChars[i] != '@' || firstChars[i + 2] != '+')
+                continue;
+            if (!pairs)
+                return starts[i];
+            // compare the names of this record and the next one, they are equal for the mates of a pair
+            std::string id1(starts[i + 1] - starts[i] - 2, '\0'), id2(starts[i + 5] - starts[i + 4] - 2, '\0');  // without '@' and '\n'
+            if (!_seek(file, starts[i] + 1) || std::fread(&id1[0], 1, id1.size(), file) != id1.size() ||
+                !_seek(file, starts[i + 4] + 1) || std::fread(&id2[0], 1, id2.size(), file) != id2.size())
+                throw std::runtime_error("Can not read the input file.");
+            if (_sameMateName(id1, id2))
+                return starts[i];
+            return starts[i + 4];   // this is a second mate, the next record starts the next pair
+        }
+        if (complete)
+            return size;
+    }
+}
+
+// Walks over the record starts from begin, which has to be a record start itself, and stops at the start
+// of record maxRecords (begin is record 0) or at end. Returns the offset where it stopped, records is set
+// to the number of records in front of it. This only looks at line breaks, the records are not parsed.
+inline std::uint64_t scanRecords(std::FILE* file, const std::uint64_t begin, const std::uint64_t end, const std::uint64_t maxRecords,
+    const RecordFormat format, std::uint64_t& records)
+{
+    records = 0;
+    if (!_seek(file, begin))
+        throw std::runtime_error("Can not seek in the input file.");
+    std::vector<char> buffer(1 << 20);
+    std::uint64_t pos = begin;
+    std::uint64_t lines = 0;
+    bool lineStart = true;
+    while (pos < end)
+    {
+        const auto numRead = std::fread(buffer.data(), 1, static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), end - pos)), file);
+        if (numRead == 0)
+            break;
+        std::size_t i = 0;
+        while (i < numRead)
+        {
+            if (lineStart)
+            {
+                if (format == RecordFormat::fastq ? lines % 4 == 0 : buffer[i] == '>')
+                {
+                    if (records == maxRecords)
+                        return pos + i;
+                    ++records;
+                }
+                lineStart = false;
+            }
+            const auto lineEnd = static_cast<const char*>(std::memchr(buffer.data() + i, '\n', numRead - i));
+            if (lineEnd == nullptr)
+                break;
+            i = lineEnd - buffer.data() + 1;
+            ++lines;
+            lineStart = true;
+        }
+        pos += numRead;
+    }
+    return pos;
+}
+
+// Returns the id of the record that starts at offset, without the leading '@' or '>'.
+inline std::string recordId(std::FILE* file, const std::uint64_t offset)
+{
+    if (!_seek(file, offset) || std::fgetc(file) == EOF)
+        throw std::runtime_error("Can not read the input file.");
+    std::string id;
+    int c;
+    while ((c = std::fgetc(file)) != EOF && c != '\n')
+        id.push_back(static_cast<char>(c));
+    if (!id.empty() && id.back() == '\r')
+        id.pop_back();
+    return id;
+}
+
+// Returns the start of the record with the mate name of id in the second file of a pair, searched in a window of
+// records around position. The mates are at about the same relative position of both files, so this finds the mate
+// without scanning the file up to it. Returns size if the mate is not in the window.
+inline std::uint64_t findMateRecord(std::FILE* file, const std::string& id, const std::uint64_t position, const std::uint64_t size,
+    const RecordFormat format, const std::uint64_t window)
+{
+    std::uint64_t pos = nextRecordStart(file, position > window ? position - window : 0, size, format, false);
+    const auto last = std::min(size, position + window);
+    if (pos >= last)
+        return size;
+    std::vector<char> buffer(static_cast<std::size_t>(last - pos));
+    if (!_seek(file, pos) || std::fread(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        throw std::runtime_error("Can not read the input file.");
+    // only record starts are compared, a record that ends behind the window is not looked at
+    const char* it = buffer.data();
+    const char* const end = it + buffer.size();
+    std::string recordName;
+    while (it != end)
+    {
+        const char *first, *lineEnd;
+        _getLine(it, end, first, lineEnd);
+        if (lineEnd == end && last != size)
+            break;      // the id line is cut off by the window
+        recordName.assign(first + 1, lineEnd);
+        if (_sameMateName(id, recordName))
+            return pos + (first - buffer.data());
+        if (format == RecordFormat::fastq)
+        {
+            for (unsigned int i = 0; i < 3 && it != end; ++i)
+                _getLine(it, end, first, lineEnd);
+        }
+        else
+        {
+            while (it != end && *it != '>')
+                _getLine(it, end, first, lineEnd);
+        }
+    }
+    return size;
+}
+
+// Reads the byte range [begin, end) of a file.
+class FileRangeInputSource : public InputSource
+{
+    std::FILE* _file;
+    const std::uint64_t _end;
+    std::uint64_t _remaining;
+
+    FileRangeInputSource(const FileRangeInputSource&) = delete;
+    FileRangeInputSource& operator=(const FileRangeInputSource&) = delete;
+public:
+    FileRangeInputSource(std::FILE* file, const std::uint64_t begin, const std::uint64_t end) : _file(file), _end(end), _remaining(end - begin)
+    {
+        if (!_seek(_file, begin))
+            throw std::runtime_error("Can not seek in the input file.");
+    }
+    ~FileRangeInputSource()
+    {
+        std::fclose(_file);
+    }
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        const auto numRead = std::fread(buffer, 1, static_cast<std::size_t>(std::min<std::uint64_t>(len, _remaining)), _file);
+        _remaining -= numRead;
+        return numRead;
+    }
+    bool seek(const std::uint64_t offset) override
+    {
+        if (offset > _end || !_seek(_file, offset))
+            return false;
+        _remaining = _end - offset;
+        return true;
+    }
+};
@@ -66,7 +66,8 @@ struct Mean {
 // Functions
 // ============================================================================
 
-inline unsigned getQuality(const seqan::String<seqan::Dna5Q>& seq, unsigned i)
+template <typename TSeq>
+inline unsigned getQuality(const TSeq& seq, unsigned i)
 {
 	return seqan::getQualityValue(seq[i]);
 }
@@ -133,7 +134,7 @@ template <typename TSeq, typename TSpec>
 unsigned trimRead(TSeq& seq, unsigned const cutoff, TSpec const & spec) noexcept
 {
 	unsigned ret, cut_pos;
-	cut_pos = _trimRead(seqan::Dna5QString(seq), cutoff, spec);
+	cut_pos = _trimRead(seq, cutoff, spec);
 	ret = length(seq) - cut_pos;
 	erase(seq, cut_pos, length(seq));
     return ret;
@@ -149,7 +150,7 @@ template <typename TRead, typename TSpec, typename TTagTrimming>
 unsigned _trimReads(std::vector<TRead>& reads, unsigned const cutoff, const TSpec& spec, TTagTrimming) noexcept(!TTagTrimming::value)
 {
     int trimmedReads = 0;
-    std::transform(reads.begin(),reads.end(),reads.begin(),[&trimmedReads, cutoff, &spec](auto& read)->auto
+    for (auto& read : reads)    // in place, the reads must not be copied
     {
         if (trimRead(read.seq, cutoff, spec))
         {
@@ -157,8 +158,7 @@ unsigned _trimReads(std::vector<TRead>& reads, unsigned const cutoff, const TSpe
             if (TTagTrimming::value)
                 append(read.id, "[Trimmed]");
         }
-        return read;
-    });
+    }
     return trimmedReads;
 }
 
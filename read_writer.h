@@ -4,35 +4,275 @@
 
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
 #include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "bgzf.h"
+#include "ptc.h"
+
+// Cuts the file to len bytes.
+inline bool truncateFile(const std::string& path, const std::uint64_t len)
+{
+#ifdef _WIN32
+    int fd;
+    if (_sopen_s(&fd, path.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, 0) != 0)
+        return false;
+    const bool ok = _chsize_s(fd, static_cast<__int64>(len)) == 0;
+    _close(fd);
+    return ok;
+#else
+    return truncate(path.c_str(), static_cast<off_t>(len)) == 0;
+#endif
+}
+
+#if SEQAN_HAS_ZLIB
+// Writes FASTQ or FASTA records into a BGZF file. Full blocks are compressed by the threads
+// of a pool, the finished blocks are written in order by the thread that writes the records.
+class BgzfFileOut
+{
+    std::FILE* _file;
+    ptc::TaskPool& _pool;
+    const bool _fasta;
+    std::vector<char> _buffer;      // formatted records, not yet submitted
+    std::deque<std::future<std::vector<unsigned char>>> _blocks;    // blocks that are being compressed, in file order
+    const std::size_t _maxPending;
+
+    static constexpr unsigned int fastaLineLength = 70;
+
+    BgzfFileOut(const BgzfFileOut&) = delete;
+    BgzfFileOut& operator=(const BgzfFileOut&) = delete;
+
+    void _write(const unsigned char* data, const std::size_t len)
+    {
+        if (std::fwrite(data, 1, len, _file) != len)
+            throw std::runtime_error("Could not write to output file.");
+    }
+
+    // writes the finished blocks, blocks for the oldest one if too many are pending
+    void _writeBlocks(const bool waitForAll)
+    {
+        while (!_blocks.empty() && (waitForAll || _blocks.size() > _maxPending ||
+            _blocks.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+        {
+            const auto block = _blocks.front().get();
+            _blocks.pop_front();
+            _write(block.data(), block.size());
+        }
+    }
+
+    void _submitBlocks(const bool all)
+    {
+        std::size_t pos = 0;
+        while (_buffer.size() - pos >= bgzfMaxBlockData || (all && pos != _buffer.size()))
+        {
+            const auto len = std::min(bgzfMaxBlockData, _buffer.size() - pos);
+            std::vector<char> data(_buffer.begin() + pos, _buffer.begin() + pos + len);
+            _blocks.push_back(_pool.submit([data = std::move(data)]() {return deflateBgzfBlock(data);}));
+            pos += len;
+        }
+        _buffer.erase(_buffer.begin(), _buffer.begin() + pos);
+        _writeBlocks(false);
+    }
+
+public:
+    // With append, the blocks are added to an existing file, which has to end after a complete block.
+    BgzfFileOut(const char* fileName, ptc::TaskPool& pool, const unsigned int numThreads, const bool fasta, const bool append = false)
+        : _file(std::fopen(fileName, append ? "ab" : "wb")), _pool(pool), _fasta(fasta), _maxPending(4 * numThreads)
+    {
+        if (_file == nullptr)
+            throw std::runtime_error(std::string("Could not open output file ") + fileName);
+        _buffer.reserve(2 * bgzfMaxBlockData);
+    }
+    ~BgzfFileOut()
+    {
+        try
+        {
+            _submitBlocks(true);
+            _writeBlocks(true);
+            _write(bgzfEofBlock, sizeof(bgzfEofBlock));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "\n" << e.what() << std::endl;
+        }
+        std::fclose(_file);
+    }
+
+    template <typename TSeq>
+    void writeRecord(const std::string& id, const TSeq& seq)
+    {
+        const auto len = length(seq);
+        _buffer.push_back(_fasta ? '>' : '@');
+        _buffer.insert(_buffer.end(), id.begin(), id.end());
+        _buffer.push_back('\n');
+        for (unsigned int i = 0; i < len; ++i)
+        {
+            _buffer.push_back(seqan::convert<char>(seq[i]));
+            if (_fasta && (i + 1) % fastaLineLength == 0 && i + 1 != len)
+                _buffer.push_back('\n');
+        }
+        _buffer.push_back('\n');
+        if (!_fasta)
+        {
+            _buffer.push_back('+');
+            _buffer.push_back('\n');
+            for (unsigned int i = 0; i < len; ++i)
+                _buffer.push_back(static_cast<char>(seqan::getQualityValue(seq[i]) + '!'));
+            _buffer.push_back('\n');
+        }
+        if (_buffer.size() >= bgzfMaxBlockData)
+            _submitBlocks(false);
+    }
+
+    // Writes all records and returns the file length. The file is valid up to there, except for the end of file marker.
+    std::uint64_t flush()
+    {
+        _submitBlocks(true);
+        _writeBlocks(true);
+        if (std::fflush(_file) != 0)
+            throw std::runtime_error("Could not write to output file.");
+#ifdef _WIN32
+        return static_cast<std::uint64_t>(_ftelli64(_file));
+#else
+        return static_cast<std::uint64_t>(ftello(_file));
+#endif
+    }
+};
+#endif  // SEQAN_HAS_ZLIB
+
+// One output file, written either by seqan or, for compressed output with threads, by a BgzfFileOut.
+class OutputFile
+{
+    std::shared_ptr<seqan::SeqFileOut> _seqFile;    // shared by both mates for interleaved output
+#if SEQAN_HAS_ZLIB
+    std::unique_ptr<BgzfFileOut> _bgzfFile;
+#endif
+    std::string _path;
+public:
+    // With append, the records are added to an existing file.
+    OutputFile(const std::string& path, const bool append = false) : _path(path)
+    {
+        if (!append)
+        {
+            _seqFile = std::make_shared<seqan::SeqFileOut>(path.c_str());
+            return;
+        }
+        _seqFile = std::make_shared<seqan::SeqFileOut>();
+        if (!open(*_seqFile, path.c_str(), seqan::OPEN_WRONLY | seqan::OPEN_CREATE | seqan::OPEN_APPEND))
+            throw std::runtime_error("Could not open output file " + path);
+    }
+    OutputFile(std::shared_ptr<seqan::SeqFileOut> seqFile) : _seqFile(std::move(seqFile)) {};
+#if SEQAN_HAS_ZLIB
+    OutputFile(const std::string& path, ptc::TaskPool& pool, const unsigned int numThreads, const bool fasta, const bool append = false) : _path(path)
+    {
+        _bgzfFile = std::make_unique<BgzfFileOut>(path.c_str(), pool, numThreads, fasta, append);
+    }
+#endif
+
+    inline const std::string& path() const noexcept
+    {
+        return _path;
+    }
+
+    // Writes all records and returns the file length.
+    std::uint64_t flush()
+    {
+#if SEQAN_HAS_ZLIB
+        if (_bgzfFile)
+            return _bgzfFile->flush();
+#endif
+        _seqFile->stream.flush();
+        const auto pos = _seqFile->stream.tellp();
+        if (!_seqFile->stream || pos < 0)
+            throw std::runtime_error("Could not write to output file " + _path);
+        return static_cast<std::uint64_t>(pos);
+    }
+
+    template <typename TSeq>
+    inline void writeRecord(const std::string& id, const TSeq& seq)
+    {
+#if SEQAN_HAS_ZLIB
+        if (_bgzfFile)
+        {
+            _bgzfFile->writeRecord(id, seq);
+            return;
+        }
+#endif
+        seqan::writeRecord(*_seqFile, id, seq);
+    }
+};
 
 class OutputStreams
 {
-    using TSeqStream = std::unique_ptr<seqan::SeqFileOut>;
+    using TSeqStream = std::unique_ptr<OutputFile>;
     using TStreamPair = std::pair<TSeqStream, TSeqStream>;
-    std::map<int, TStreamPair> fileStreams;
+#if SEQAN_HAS_ZLIB
+    std::unique_ptr<ptc::TaskPool> _compressionPool;  // has to outlive the streams, they use it until they are closed
+#endif
+    std::shared_ptr<seqan::SeqFileOut> _stdoutFile;
+    std::vector<TStreamPair> fileStreams;    // indexed by the demultiplexing result, 0 is unidentified
     const std::string basePath;
     std::string extension;
+    std::string _baseSuffix;    // appended to the base path, e.g. to tell the output of different shards apart
+    std::map<std::string, std::uint64_t> _resumeLengths;    // files that are continued, with their valid length
+    unsigned int _compressionThreads;
+    unsigned int _writerThreads;
+    bool _interleaved;      // both mates go into the first stream of a pair
+    std::unique_ptr<ptc::TaskPool> _writerPool;
+    std::vector<std::vector<unsigned int>> _buckets;     // read indices of the current batch for every stream
 
     template < typename TStream, template<typename> class TRead, typename TSeq,
         typename = std::enable_if_t < std::is_same<TRead<TSeq>, Read<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplex<TSeq>>::value  > >
-        inline void writeRecord(TStream& stream, TRead<TSeq>&& read, bool = false)
+        inline void writeRecord(TStream& stream, const TRead<TSeq>& read, bool = false)
     {
-        seqan::writeRecord(*(stream.first), std::move(read.id), std::move(read.seq));
+        stream.first->writeRecord(read.id, read.seq);
     }
 
     template <typename TStream, template<typename> class TRead, typename TSeq,
         typename = std::enable_if_t < std::is_same<TRead<TSeq>, ReadPairedEnd<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplexPairedEnd<TSeq>>::value  > >
-        inline void writeRecord(TStream& stream, TRead<TSeq>&& read)
+        inline void writeRecord(TStream& stream, const TRead<TSeq>& read)
+    {
+        stream.first->writeRecord(read.id, read.seq);
+        (stream.second ? stream.second : stream.first)->writeRecord(read.idRev, read.seqRev);
+    }
+
+    template <typename TReads>
+    void _writeBucket(const unsigned int streamIndex, const TReads& reads)
+    {
+        auto& stream = fileStreams[streamIndex];
+        for (const auto i : _buckets[streamIndex])
+            writeRecord(stream, reads[i]);
+    }
+
+    // FASTQ and FASTA output is compressed by the pool if the file ends in .gz
+    bool _useCompressionPool(bool& fasta) const
     {
-        seqan::writeRecord(*(stream.first), std::move(read.id), std::move(read.seq));
-        seqan::writeRecord(*(stream.second), std::move(read.idRev), std::move(read.seqRev));
+        if (_compressionThreads < 2 || !seqan::endsWith(extension, ".gz"))
+            return false;
+        fasta = seqan::startsWith(extension, ".fa.") || seqan::startsWith(extension, ".fasta.") || seqan::startsWith(extension, ".fna.");
+        return fasta || seqan::startsWith(extension, ".fq.") || seqan::startsWith(extension, ".fastq.");
     }
 
     //Adds a new output streams to the collection of streams.
     void _addStream(TSeqStream& stream, const std::string fileName, int id, bool useDefault)
     {
         (void)id;
+        if (_stdoutFile)
+        {
+            stream = std::make_unique<OutputFile>(_stdoutFile);
+            return;
+        }
         std::string path = getBaseFilename();
         if (fileName != "")
             path += "_";
@@ -40,15 +280,36 @@ class OutputStreams
             path += "_result";
 
         path += fileName + extension;
-        stream = std::make_unique<seqan::SeqFileOut>(path.c_str());
+        const auto resumed = _resumeLengths.find(path);
+        const bool append = resumed != _resumeLengths.end();
+        if (append && !truncateFile(path, resumed->second))
+            throw std::runtime_error("Could not truncate output file " + path);
+#if SEQAN_HAS_ZLIB
+        bool fasta = false;
+        if (_useCompressionPool(fasta))
+        {
+            if (!_compressionPool)
+                _compressionPool = std::make_unique<ptc::TaskPool>(_compressionThreads);
+            stream = std::make_unique<OutputFile>(path, *_compressionPool, _compressionThreads, fasta, append);
+            return;
+        }
+#endif
+        stream = std::make_unique<OutputFile>(path, append);
     }
 
 
 public:
     // The correct file extension is determined from the base path, according to the available
     // file extensions of the SeqFileOut and used for all stored files.
-    OutputStreams(const std::string& base, bool /*noQuality*/) : basePath(base)
+    // With more than one compression thread, .gz output is written as BGZF and compressed in parallel.
+    // With more than one writer thread, the streams are split into groups that are written in parallel.
+    // With interleaved output, paired-end reads are written into one file per stream.
+    OutputStreams(const std::string& base, bool /*noQuality*/, const unsigned int compressionThreads = 1, const unsigned int writerThreads = 1,
+        const bool interleaved = false) :
+        basePath(base), _compressionThreads(compressionThreads), _writerThreads(writerThreads), _interleaved(interleaved)
     {
+        if (_writerThreads > 1)
+            _writerPool = std::make_unique<ptc::TaskPool>(_writerThreads);
         std::vector<std::string> tmpExtensions = seqan::SeqFileOut::getFileExtensions();
         for(const auto& tmpExtension : tmpExtensions)
         {
@@ -60,18 +321,73 @@ public:
         }
     }
 
+    // All streams that are added afterwards write to stream, both mates of a pair are interleaved.
+    void openStdout(std::ostream& stream, const bool noQuality)
+    {
+        if (noQuality)
+            _stdoutFile = std::make_shared<seqan::SeqFileOut>(stream, seqan::Fasta());
+        else
+            _stdoutFile = std::make_shared<seqan::SeqFileOut>(stream, seqan::Fastq());
+    }
+
+    // Has to be called before any stream is added.
+    void setBaseSuffix(const std::string& suffix)
+    {
+        _baseSuffix = suffix;
+    }
+
+    // Output files that are listed here are cut to the given length and continued instead of being overwritten.
+    // Has to be called before any stream is added.
+    void resume(const std::vector<std::pair<std::string, std::uint64_t>>& lengths)
+    {
+        _resumeLengths.clear();
+        _resumeLengths.insert(lengths.begin(), lengths.end());
+    }
+
+    // Checks if the output files are still valid after cutting them to the length they had at a flush(),
+    // this is not the case for compressed files, apart from BGZF.
+    bool truncatable() const
+    {
+        if (_stdoutFile)
+            return false;
+#if SEQAN_HAS_ZLIB
+        bool fasta = false;
+        if (_useCompressionPool(fasta))
+            return true;
+#endif
+        return !(seqan::endsWith(extension, ".gz") || seqan::endsWith(extension, ".bgzf") || seqan::endsWith(extension, ".bz2"));
+    }
+
+    // Writes all records of the output files and returns their lengths.
+    std::vector<std::pair<std::string, std::uint64_t>> flush()
+    {
+        std::vector<std::pair<std::string, std::uint64_t>> lengths;
+        for (auto& streamPair : fileStreams)
+        {
+            if (streamPair.first)
+                lengths.emplace_back(streamPair.first->path(), streamPair.first->flush());
+            if (streamPair.second)
+                lengths.emplace_back(streamPair.second->path(), streamPair.second->flush());
+        }
+        return lengths;
+    }
+
     inline std::string getBaseFilename(void) const
     {
-        return prefix(basePath, length(basePath) - length(extension));
+        return std::string(prefix(basePath, length(basePath) - length(extension))) + _baseSuffix;
     }
 
     void addStream(const std::string fileName, const int streamIndex, const bool useDefault)
     {
+        if (fileStreams.size() <= static_cast<unsigned int>(streamIndex))
+            fileStreams.resize(streamIndex + 1);
         _addStream(fileStreams[streamIndex].first, fileName, streamIndex, useDefault);
     }
     
     void addStreams(const std::string fileName1, const std::string fileName2, const int streamIndex, const bool useDefault)
     {
+        if (fileStreams.size() <= static_cast<unsigned int>(streamIndex))
+            fileStreams.resize(streamIndex + 1);
         _addStream(fileStreams[streamIndex].first, fileName1, streamIndex, useDefault);
         _addStream(fileStreams[streamIndex].second, fileName2, streamIndex, useDefault);
     }
@@ -92,12 +408,13 @@ public:
     template <typename TNames>
     void updateStreams(const TNames& names, const bool pair)
     {
-
+        if (fileStreams.size() == length(names) + 1 && fileStreams.back().first)
+            return;     // the names are the same for every batch, so this is the common case
         for (unsigned i = 0; i < length(names) + 1; ++i)
         {
             const unsigned streamIndex = i;
             // If no stream for this id exists, create one.
-            if (fileStreams.find(streamIndex) == fileStreams.end())
+            if (streamIndex >= fileStreams.size() || !fileStreams[streamIndex].first)
             {
                 // If the index is 0 (unidentified) create special stream.
                 // Otherwise use index to get appropriate name for output file.
@@ -107,7 +424,7 @@ public:
                 else
                     file = "unidentified";
                 // Add file extension to stream and create it.
-                if (pair)
+                if (pair && !_interleaved)
                 {
                     std::string file2 = file;
                     file += "_1";
@@ -122,15 +439,46 @@ public:
         }
     }
 
+    // the reads are left untouched, so that their buffers can be reused for the next batch
     template <template<typename> class TRead, typename TSeq, typename TNames>
-    void writeSeqs(std::vector<TRead<TSeq>>&& reads, const TNames& names)
+    void writeSeqs(const std::vector<TRead<TSeq>>& reads, const TNames& names)
     {
         updateStreams(names, std::is_same<TRead<TSeq>, ReadPairedEnd<TSeq>>::value || std::is_same<TRead<TSeq>, ReadMultiplexPairedEnd<TSeq>>::value);
-        for(auto& read : reads)
+        if (fileStreams.size() == 1)
+        {
+            for (const auto& read : reads)
+                writeRecord(fileStreams[0], read);
+            return;
+        }
+
+        // sort the reads into one bucket per stream, each bucket is then written in one go
+        _buckets.resize(fileStreams.size());
+        for (auto& bucket : _buckets)
+            bucket.clear();
+        for (unsigned int i = 0; i < reads.size(); ++i)
+            _buckets[reads[i].demuxResult].push_back(i);
+
+        if (!_writerPool)
+        {
+            for (unsigned int streamIndex = 0; streamIndex < _buckets.size(); ++streamIndex)
+                _writeBucket(streamIndex, reads);
+            return;
+        }
+
+        // Stream i always belongs to group i % writerThreads, so every stream is written by one
+        // thread at a time and its records stay in order. All groups are finished before returning.
+        std::vector<std::future<void>> written;
+        for (unsigned int group = 0; group < _writerThreads && group < _buckets.size(); ++group)
         {
-            const unsigned streamIndex = read.demuxResult;
-            writeRecord(fileStreams[streamIndex], std::move(read));
+            written.push_back(_writerPool->submit([this, &reads, group]() {
+                for (unsigned int streamIndex = group; streamIndex < _buckets.size(); streamIndex += _writerThreads)
+                    _writeBucket(streamIndex, reads);
+            }));
         }
+        for (auto& f : written)
+            f.wait();
+        for (auto& f : written)
+            f.get();    // rethrows errors of the writer threads
     }
 
     ~OutputStreams(){}
@@ -138,7 +486,7 @@ public:
 };
 
 
-template<typename TOutputStreams, typename TProgramParams>
+template<typename TOutputStreams, typename TProgramParams, typename TReadPool, typename TCheckpointer>
 struct ReadWriter
 {
 private:
@@ -146,19 +494,24 @@ private:
 
     TOutputStreams& _outputStreams;
     const TProgramParams& _programParams;
+    TReadPool& _readPool;
+    TCheckpointer* _checkpointer;   // nullptr without checkpoints
     std::chrono::time_point<std::chrono::steady_clock> _startTime;
     std::chrono::time_point<std::chrono::steady_clock> _lastScreenUpdate;
     GeneralStats _stats;
 public:
-    ReadWriter(TOutputStreams& outputStreams, const TProgramParams& programParams) :
-        _outputStreams(outputStreams), _programParams(programParams), _startTime(std::chrono::steady_clock::now()) {};
+    ReadWriter(TOutputStreams& outputStreams, const TProgramParams& programParams, TReadPool& readPool, TCheckpointer* checkpointer) :
+        _outputStreams(outputStreams), _programParams(programParams), _readPool(readPool), _checkpointer(checkpointer), _startTime(std::chrono::steady_clock::now()) {};
 
     template <typename TItem>
     void operator()(TItem item)
     {
         const auto t1 = std::chrono::steady_clock::now();
-        _outputStreams.writeSeqs(std::move(*std::get<0>(*item)), std::get<1>(*item));
+        _outputStreams.writeSeqs(*std::get<0>(*item), std::get<1>(*item));
+        _readPool.release(std::move(std::get<0>(*item)));     // hand the written batch back to the reader
         _stats += std::get<2>(*item);
+        if (_checkpointer)
+            _checkpointer->batchWritten(_stats, _outputStreams);
 
         // terminal output
         const auto ioTime = std::chrono::duration_cast<std::chrono::duration<float>>(std::chrono::steady_clock::now() - t1).count();
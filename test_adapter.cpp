@@ -159,6 +159,24 @@ int insertSize(char* s)
 	return insert;
 }
 
+// Reproducible pseudo random numbers (a linear congruential generator), the same on every platform.
+struct TestRandom
+{
+    unsigned int state;
+
+    unsigned int operator()()
+    {
+        state = state * 1103515245u + 12345u;
+        return state;
+    }
+
+    void fill(std::vector<unsigned char>& codes, const unsigned int alphabetSize)
+    {
+        for (auto& code : codes)
+            code = ((*this)() >> 16) % alphabetSize;
+    }
+};
+
 SEQAN_DEFINE_TEST(match_test)
 {
     AdapterMatchSettings u(4, 0, 0.2, 0, 1);
@@ -313,6 +331,404 @@ SEQAN_DEFINE_TEST(align_adapter_test)
     SEQAN_ASSERT_EQ(pair.first, 0u);
 }
 
+SEQAN_DEFINE_TEST(score_shift_test)
+{
+    // N in the read scores 0, N in the adapter is a mismatch unless the read has an N, too
+    const unsigned char read[] = { 0, 1, 2, 3, 4, 4, 0, 1 };
+    const unsigned char adapter[] = { 0, 1, 3, 3, 0, 4, 4, 2 };
+    SEQAN_ASSERT_EQ(scoreShiftScalar(read, adapter, 8), 3 - 3);
+    SEQAN_ASSERT_EQ(scoreShift(read, adapter, 8), 3 - 3);
+
+    // the vector kernels have to give the same score for every length, including the scalar tails
+    std::vector<unsigned char> longRead(1000), longAdapter(1000);
+    TestRandom random{1};
+    for (unsigned int i = 0; i < longRead.size(); ++i)
+    {
+        const unsigned int r = random();
+        longRead[i] = (r >> 16) % 5;
+        longAdapter[i] = (r >> 8) % 3 == 0 ? longRead[i] : (r >> 20) % 5;
+    }
+    for (unsigned int len = 0; len <= longRead.size(); ++len)
+        SEQAN_ASSERT_EQ(scoreShift(longRead.data(), longAdapter.data(), len), scoreShiftScalar(longRead.data(), longAdapter.data(), len));
+#ifdef FLEXCAT_SSE2
+    for (unsigned int len = 0; len <= longRead.size(); ++len)
+        SEQAN_ASSERT_EQ(scoreShiftSse2(longRead.data(), longAdapter.data(), len), scoreShiftScalar(longRead.data(), longAdapter.data(), len));
+#endif
+}
+
+SEQAN_DEFINE_TEST(score_shift_packed_test)
+{
+    std::vector<unsigned char> read(300), adapter(300);
+    TestRandom random{7};
+    for (unsigned int i = 0; i < read.size(); ++i)
+    {
+        const unsigned int r = random();
+        read[i] = (r >> 16) % 5;
+        adapter[i] = (r >> 8) % 3 == 0 ? read[i] : (r >> 20) % 5;
+    }
+    PackedSequence packedRead, packedAdapter;
+    packedRead.resize(read.size());
+    packedAdapter.resize(adapter.size());
+    for (unsigned int i = 0; i < read.size(); ++i)
+    {
+        packedRead.set(i, read[i]);
+        packedAdapter.set(i, adapter[i]);
+    }
+    if (!usePackedScoring())
+        return;     // scoreShiftPacked needs a popcount instruction
+    // all combinations of word offsets, including windows that cross word borders
+    for (unsigned int readPos = 0; readPos < 140; readPos += 7)
+        for (unsigned int adapterPos = 0; adapterPos < 140; adapterPos += 11)
+            for (unsigned int len = 0; len + std::max(readPos, adapterPos) <= read.size(); len += 13)
+                SEQAN_ASSERT_EQ(scoreShiftPacked(packedRead, readPos, packedAdapter, adapterPos, len),
+                    scoreShiftScalar(read.data() + readPos, adapter.data() + adapterPos, len));
+}
+
+SEQAN_DEFINE_TEST(score_shift_lanes_test)
+{
+    // every lane has to get the score of its own read, the pad behind shorter reads scores 0
+    std::vector<std::vector<unsigned char>> reads(readLanes);
+    std::vector<unsigned char> adapter(200);
+    TestRandom random{11};
+    ReadLanes lanes;
+    lanes.reset(300);
+    for (unsigned int lane = 0; lane < readLanes; ++lane)
+    {
+        reads[lane].resize(lane * 9 + 20);
+        random.fill(reads[lane], 5);
+        lanes.set(lane, reads[lane].data(), reads[lane].size());
+    }
+    random.fill(adapter, 5);
+    int scores[readLanes];
+    for (int shiftPos = -210; shiftPos < 310; shiftPos += 3)
+    {
+        scoreShiftLanes(lanes, shiftPos, adapter.data(), adapter.size(), scores);
+        for (unsigned int lane = 0; lane < readLanes; ++lane)
+        {
+            const int lenRead = reads[lane].size();
+            const int overlap = std::min<int>(shiftPos + adapter.size(), lenRead) - std::max(shiftPos, 0);
+            const int expected = overlap <= 0 ? 0 :
+                scoreShiftScalar(reads[lane].data() + std::max(shiftPos, 0), adapter.data() + std::max(-shiftPos, 0), overlap);
+            SEQAN_ASSERT_EQ(scores[lane], expected);
+        }
+    }
+}
+
+SEQAN_DEFINE_TEST(adapter_index_test)
+{
+    // reads skipped by the q-gram filter must be trimmed exactly like without the index
+    using TSeq = seqan::Dna5QString;
+    const char bases[] = "ACGTN";
+    AdapterMatchSettings matchSettings(4, 0, 0.2, 0, 1);
+    AdapterTrimmingStats stats;
+    stats.numRemoved.resize(2);
+    const TSeq ada3("AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC");
+    const TSeq ada5("GTTCAGAGTTCTACAGTCCGACGATC");
+    AdapterSet plain{ AdapterItem(ada3, AdapterItem::end3, 0, 0, false, false), AdapterItem(ada5, AdapterItem::end5, 0, 1, false, false) };
+    AdapterSet indexed = plain;
+    buildAdapterIndex(indexed);
+    SEQAN_ASSERT(indexed[0].index.valid());
+    TestRandom random{3};
+    for (unsigned int i = 0; i < 2000; ++i)
+    {
+        TSeq read;
+        for (unsigned int k = 0; k < 100; ++k)
+        {
+            const unsigned int r = random() >> 16;
+            appendValue(read, bases[r % 97 == 0 ? 4 : r % 4]);
+        }
+        // insert an adapter with some errors at a random position
+        const unsigned int pos = (random() >> 16) % 100;
+        for (unsigned int k = 0; k < length(ada3) && pos + k < length(read) && i % 2 == 0; ++k)
+        {
+            const unsigned int r = random();
+            read[pos + k] = (r >> 16) % 10 == 0 ? TAdapterAlphabet(bases[(r >> 20) % 5]) : ada3[k];
+        }
+        TSeq read2 = read;
+        const unsigned int removed = stripAdapter(read, stats, plain, matchSettings, StripAdapterDirection<adapterDirection::forward>());
+        SEQAN_ASSERT_EQ(stripAdapter(read2, stats, indexed, matchSettings, StripAdapterDirection<adapterDirection::forward>()), removed);
+        SEQAN_ASSERT_EQ(read, read2);
+    }
+}
+
+SEQAN_DEFINE_TEST(adapter_scanner_test)
+{
+    // an adapter panel scanned in one pass must be trimmed exactly like adapter by adapter
+    using TSeq = seqan::Dna5QString;
+    const char bases[] = "ACGT";
+    AdapterMatchSettings matchSettings(4, 0, 0.2, 0, 1);
+    AdapterTrimmingStats stats;
+    stats.numRemoved.resize(16);
+    AdapterSet plain;
+    TestRandom random{5};
+    for (unsigned int id = 0; id < 16; ++id)
+    {
+        TSeq ada("AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC");
+        for (unsigned int k = 0; k < 6; ++k)
+            appendValue(ada, bases[(random() >> 16) % 4]);
+        append(ada, "ATCTCGTATGCCGTCTTCTGCTTG");
+        plain.push_back(AdapterItem(ada, id % 2 == 0 ? AdapterItem::end3 : AdapterItem::end5, 0, id, false, false));
+    }
+    AdapterSet indexed = plain;
+    buildAdapterIndex(indexed);
+    AdapterScanners scanners;
+    buildAdapterScanners(scanners, indexed, matchSettings);
+    SEQAN_ASSERT_EQ(scanners.scanners.size(), 2u);
+    for (unsigned int i = 0; i < 2000; ++i)
+    {
+        TSeq read;
+        for (unsigned int k = 0; k < 150; ++k)
+            appendValue(read, bases[(random() >> 16) % 4]);
+        const unsigned int choice = random();
+        const auto& ada = plain[(choice >> 16) % plain.size()].seq;
+        const unsigned int pos = (choice >> 8) % 150;
+        for (unsigned int k = 0; k < length(ada) && pos + k < length(read) && i % 2 == 0; ++k)
+        {
+            const unsigned int r = random();
+            read[pos + k] = (r >> 16) % 10 == 0 ? TAdapterAlphabet(bases[(r >> 20) % 4]) : ada[k];
+        }
+        TSeq read2 = read;
+        const unsigned int removed = stripAdapter(read, stats, plain, matchSettings, StripAdapterDirection<adapterDirection::forward>());
+        SEQAN_ASSERT_EQ(stripAdapter(read2, stats, indexed, matchSettings, StripAdapterDirection<adapterDirection::forward>(), &scanners), removed);
+        SEQAN_ASSERT_EQ(read, read2);
+    }
+}
+
+SEQAN_DEFINE_TEST(adapter_table_test)
+{
+    // the tables only hold the adapters of their direction which are long enough, with their ids
+    using TSeq = seqan::Dna5QString;
+    AdapterSet adapters;
+    adapters.push_back(AdapterItem(TSeq("AGATCGGAAGAGC"), AdapterItem::end3, 0, 0, false, false));
+    adapters.push_back(AdapterItem(TSeq("ACG"), AdapterItem::end3, 0, 1, false, false));
+    adapters.push_back(AdapterItem(TSeq("GATCGTCGGACT"), AdapterItem::end5, 0, 2, false, true));
+    const AdapterMatchSettings matchSettings(4, 0, 0.1, 0, 1);
+    AdapterTable forwardAdapters, reverseAdapters;
+    buildAdapterTable(forwardAdapters, adapters, false, matchSettings);
+    buildAdapterTable(reverseAdapters, adapters, true, matchSettings);
+    SEQAN_ASSERT_EQ(forwardAdapters.adapters.size(), 1u);
+    SEQAN_ASSERT_EQ(forwardAdapters.adapters[0].id, 0u);
+    SEQAN_ASSERT(forwardAdapters.adapters[0].index.built());
+    SEQAN_ASSERT_EQ(reverseAdapters.adapters.size(), 1u);
+    SEQAN_ASSERT_EQ(reverseAdapters.adapters[0].id, 2u);
+
+    const AdapterItem reverseComplement = adapters[0].getReverseComplement();
+    SEQAN_ASSERT_EQ(reverseComplement.seq, TSeq("GCTCTTCCGATCT"));
+    SEQAN_ASSERT_EQ(reverseComplement.id, 0u);
+    SEQAN_ASSERT(!reverseComplement.index.built());
+}
+
+SEQAN_DEFINE_TEST(strip_adapter_batch_test)
+{
+    // a batch must be trimmed and tagged exactly like read by read, with the same statistics
+    using TSeq = seqan::Dna5QString;
+    const char bases[] = "ACGT";
+    const AdapterMatchSettings matchSettings(4, 0, 0.2, 0, 2);
+    const TSeq ada3("AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC");
+    const TSeq anchored3("TGGAATTCTCGGGTGCCAAGG");
+    const TSeq anchored5("GTTCAGAGTTCTACAGTCCGACGATC");
+    const AdapterSet adapters{ AdapterItem(ada3, AdapterItem::end3, 0, 0, false, false), AdapterItem(anchored3, AdapterItem::end3, 0, 1, true, false),
+        AdapterItem(anchored5, AdapterItem::end5, 0, 2, true, false) };
+    AdapterTable forwardAdapters, reverseAdapters;
+    buildAdapterTable(forwardAdapters, adapters, false, matchSettings);
+    buildAdapterTable(reverseAdapters, adapters, true, matchSettings);
+
+    // reads of different lengths, some empty, with a 3' adapter, an anchored 3' adapter or both an anchored 5' and a 3' adapter
+    TestRandom random{29};
+    std::vector<Read<TSeq>> reads(240);
+    for (unsigned int i = 0; i < reads.size(); ++i)
+    {
+        auto& read = reads[i];
+        read.id = "read" + std::to_string(i) + " 1:N:0";
+        if (i % 20 == 0)
+            continue;
+        const unsigned int len = 20 + (random() >> 16) % 131;
+        for (unsigned int k = 0; k < len; ++k)
+            appendValue(read.seq, bases[(random() >> 16) % 4]);
+        const unsigned int kind = (random() >> 16) % 4;
+        if (kind == 1 || kind == 3)
+        {
+            const unsigned int pos = (random() >> 16) % len;
+            for (unsigned int k = 0; k < length(ada3) && pos + k < len; ++k)
+            {
+                const unsigned int r = random();
+                read.seq[pos + k] = (r >> 16) % 10 == 0 ? TAdapterAlphabet(bases[(r >> 20) % 4]) : ada3[k];
+            }
+        }
+        if (kind == 2)
+            append(read.seq, anchored3);
+        if (kind == 3)
+            insert(read.seq, 0, anchored5);
+    }
+
+    std::vector<Read<TSeq>> expected = reads;
+    AdapterTrimmingStats stats, expectedStats;
+    stats.numRemoved.resize(3);
+    expectedStats.numRemoved.resize(3);
+    for (auto& read : expected)
+        if (!seqan::empty(read.seq) && stripAdapter(read.seq, expectedStats, forwardAdapters.adapters, matchSettings,
+            StripAdapterDirection<adapterDirection::forward>(), &forwardAdapters.scanners) != 0)
+            insertAfterFirstToken(read.id, ":AdapterRemoved");
+    stripAdapterBatch(reads, forwardAdapters, reverseAdapters, matchSettings, false, stats, TagAdapter<true>());
+    for (unsigned int i = 0; i < reads.size(); ++i)
+    {
+        SEQAN_ASSERT_EQ(reads[i].seq, expected[i].seq);
+        SEQAN_ASSERT_EQ(reads[i].id, expected[i].id);
+    }
+    SEQAN_ASSERT(stats.numRemoved == expectedStats.numRemoved);
+    SEQAN_ASSERT(stats.removedLength == expectedStats.removedLength);
+    SEQAN_ASSERT_EQ(stats.overlapSum, expectedStats.overlapSum);
+    SEQAN_ASSERT_EQ(stats.minOverlap, expectedStats.minOverlap);
+    SEQAN_ASSERT_EQ(stats.maxOverlap, expectedStats.maxOverlap);
+    SEQAN_ASSERT_GT(expectedStats.numRemoved[1], 0u);
+    SEQAN_ASSERT_GT(expectedStats.numRemoved[2], 0u);
+}
+
+SEQAN_DEFINE_TEST(score_overlap_test)
+{
+    // N scores 0 on both sides
+    const unsigned char seq1[] = { 0, 1, 2, 3, 4, 4, 0, 1 };
+    const unsigned char seq2[] = { 0, 1, 3, 3, 0, 4, 4, 2 };
+    SEQAN_ASSERT_EQ(scoreOverlapScalar(seq1, seq2, 8), 3 - 2);
+    if (!usePackedScoring())
+        return;
+    std::vector<unsigned char> read1(300), read2(300);
+    TestRandom random{13};
+    for (unsigned int i = 0; i < read1.size(); ++i)
+    {
+        const unsigned int r = random();
+        read1[i] = (r >> 16) % 5;
+        read2[i] = (r >> 8) % 3 == 0 ? read1[i] : (r >> 20) % 5;
+    }
+    PackedSequence packed1, packed2;
+    _toPackedSequence(read1, packed1);
+    _toPackedSequence(read2, packed2);
+    for (unsigned int pos1 = 0; pos1 < 140; pos1 += 7)
+        for (unsigned int pos2 = 0; pos2 < 140; pos2 += 11)
+            for (unsigned int len = 0; len + std::max(pos1, pos2) <= read1.size(); len += 13)
+                SEQAN_ASSERT_EQ(scoreOverlapPacked(packed1, pos1, packed2, pos2, len), scoreOverlapScalar(read1.data() + pos1, read2.data() + pos2, len));
+}
+
+SEQAN_DEFINE_TEST(best_shift_bounded_test)
+{
+    // abandoning hopeless shifts must not change whether and where the adapter matches
+    std::vector<unsigned char> read(250), adapter(150);
+    TestRandom random{17};
+    for (unsigned int i = 0; i < 500; ++i)
+    {
+        random.fill(adapter, 4);
+        const unsigned int pos = (random.state >> 8) % read.size();
+        for (unsigned int k = 0; k < read.size(); ++k)
+        {
+            const unsigned int r = random();
+            read[k] = k >= pos && k - pos < adapter.size() && i % 2 == 0 && (r >> 20) % 10 != 0 ? adapter[k - pos] : (r >> 16) % 5;
+        }
+        PackedSequence readPacked, adapterPacked;
+        _toPackedSequence(read, readPacked);
+        _toPackedSequence(adapter, adapterPacked);
+        const AdapterMatchSettings matchSettings(3, i % 7, i % 3 == 0 ? 0.0 : 0.05 * (i % 5), 0, 1);
+        const int shiftStart = 1 - static_cast<int>(adapter.size());
+        const int shiftEnd = read.size() - 1;
+        for (const bool packed : { false, true })
+        {
+            if (packed && !usePackedScoring())
+                continue;
+            const AdapterMatch all = _bestShift(read, readPacked, adapter, adapterPacked, read.size(), adapter.size(), shiftStart, shiftEnd, packed);
+            const AdapterMatch bounded = _bestShift(read, readPacked, adapter, adapterPacked, read.size(), adapter.size(), shiftStart, shiftEnd,
+                packed, &matchSettings);
+            const bool matched = all.score >= 0 && isMatch(all.overlap, (static_cast<int>(all.overlap) - all.score) / 2, matchSettings);
+            SEQAN_ASSERT_EQ(bounded.score >= 0 && isMatch(bounded.overlap, (static_cast<int>(bounded.overlap) - bounded.score) / 2, matchSettings), matched);
+            if (matched)
+            {
+                SEQAN_ASSERT_EQ(bounded.shiftPos, all.shiftPos);
+                SEQAN_ASSERT_EQ(bounded.score, all.score);
+            }
+        }
+    }
+}
+
+SEQAN_DEFINE_TEST(edit_distance_scan_test)
+{
+    // the bit-parallel columns must be the ones of the plain dynamic programming, also over several blocks
+    TestRandom random{23};
+    for (unsigned int i = 0; i < 200; ++i)
+    {
+        std::vector<unsigned char> pattern(1 + i % 150), text(i % 170);
+        random.fill(pattern, 5);
+        for (auto& base : text)
+        {
+            const unsigned int r = random();
+            base = (r >> 8) % 3 == 0 ? pattern[(r >> 16) % pattern.size()] : (r >> 20) % 5;
+        }
+        const std::size_t freeRows = i % 3 == 0 ? i % 70 : 0;
+        EditPattern editPattern;
+        buildEditPattern(pattern.data(), pattern.size(), editPattern);
+        std::vector<int> lastRow, lastColumn;
+        editDistanceScan(editPattern, text.data(), text.size(), freeRows, lastRow, lastColumn);
+
+        std::vector<int> column(pattern.size() + 1), previous(pattern.size() + 1);
+        for (std::size_t k = 0; k <= pattern.size(); ++k)
+            column[k] = k > freeRows ? static_cast<int>(k - freeRows) : 0;
+        SEQAN_ASSERT_EQ(lastRow[0], column.back());
+        for (std::size_t j = 0; j < text.size(); ++j)
+        {
+            std::swap(column, previous);
+            column[0] = 0;
+            for (std::size_t k = 1; k <= pattern.size(); ++k)
+            {
+                const bool equal = pattern[k - 1] == text[j] || pattern[k - 1] == dna5CodeN || text[j] == dna5CodeN;
+                column[k] = std::min(previous[k - 1] + (equal ? 0 : 1), std::min(previous[k], column[k - 1]) + 1);
+            }
+            SEQAN_ASSERT_EQ(lastRow[j + 1], column.back());
+        }
+        if (text.empty())
+            continue;
+        for (std::size_t k = 0; k <= pattern.size(); ++k)
+            SEQAN_ASSERT_EQ(lastColumn[k], column[k]);
+    }
+}
+
+SEQAN_DEFINE_TEST(gapped_adapter_test)
+{
+    typedef seqan::String<seqan::Dna5Q> TSeq;
+    AdapterMatchSettings matchSettings(4, 0, 0.1, 0, 1);
+    AdapterTrimmingStats stats;
+    stats.numRemoved.resize(1);
+    const TSeq ada("AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC");
+    const AdapterSet adapterSet{ AdapterItem(ada, AdapterItem::end3, 0, 0, false, false) };
+
+    // one base of the adapter is deleted, the shifts only match the part in front of the deletion
+    TSeq read("TTGACCATGCAAGTCCAGATCGGAAGAGCACACGTCGAACTCCAGTCACGGTT");
+    TSeq read2 = read;
+    stripAdapter(read, stats, adapterSet, matchSettings, StripAdapterDirection<adapterDirection::forward>());
+    SEQAN_ASSERT_EQ(read, TSeq("TTGACCATGCAAGTCCAGATCGGAAGAGCACACGTCGAACTCCAGTCACGGTT"));
+    matchSettings.gapped = true;
+    SEQAN_ASSERT_EQ(stripAdapter(read2, stats, adapterSet, matchSettings, StripAdapterDirection<adapterDirection::forward>()), 37u);
+    SEQAN_ASSERT_EQ(read2, TSeq("TTGACCATGCAAGTCC"));
+
+    // 5' adapter with an inserted base
+    TSeq read3("GAACTCCAGTCACATCTCGTATGCCGTCTTCTGCTTGTTTTTTCCAGGTA");
+    const AdapterSet adapterSet5{ AdapterItem(TSeq("GAACTCCAGTCACATCTCGTATGCCGTCTCTGCTTG"), AdapterItem::end5, 0, 0, false, false) };
+    SEQAN_ASSERT_EQ(stripAdapter(read3, stats, adapterSet5, matchSettings, StripAdapterDirection<adapterDirection::forward>()), 37u);
+    SEQAN_ASSERT_EQ(read3, TSeq("TTTTTTCCAGGTA"));
+
+    // with an overhang the error rate of the part at the read start is taken over its 24 aligned bases,
+    // not over the whole adapter, so the complete adapter behind it wins
+    matchSettings.errorRate = 0.07;
+    const AdapterSet adapterSetOverhang{ AdapterItem(ada, AdapterItem::end3, 10, 0, false, false) };
+    TSeq read4("AGCACTCGTCTGAACACCAGTCACTTGACCATGCAAGTCCTTGAAGATCGGATGAGCACACGTCTGAACGCCAGTCACGGTTCAAT");
+    SEQAN_ASSERT_EQ(stripAdapter(read4, stats, adapterSetOverhang, matchSettings, StripAdapterDirection<adapterDirection::forward>()), 42u);
+    SEQAN_ASSERT_EQ(read4, TSeq("AGCACTCGTCTGAACACCAGTCACTTGACCATGCAAGTCCTTGA"));
+    matchSettings.errorRate = 0.1;
+
+    const TSeq seq("CCCCAGATCGGAGAGC");
+    const TSeq ada2("AGATCGGAAGAGC");
+    std::pair<int, seqan::Align<TSeq> > pair;
+    alignPair(pair, seq, ada2, 0, 0, AlignAlgorithm::Myers());
+    SEQAN_ASSERT_EQ(pair.first, 13 - 2);
+    SEQAN_ASSERT_EQ(length(row(pair.second, 0)), 17u);
+}
+
 SEQAN_DEFINE_TEST(strip_pair_test)
 {
 	typedef seqan::String<seqan::Dna5Q> TSeq;
@@ -336,6 +752,17 @@ SEQAN_BEGIN_TESTSUITE(test_my_app_funcs)
 	SEQAN_CALL_TEST(match_test);
 	SEQAN_CALL_TEST(strip_adapter_test);
 	SEQAN_CALL_TEST(align_adapter_test);
+	SEQAN_CALL_TEST(score_shift_test);
+	SEQAN_CALL_TEST(score_shift_packed_test);
+	SEQAN_CALL_TEST(score_shift_lanes_test);
+	SEQAN_CALL_TEST(adapter_index_test);
+	SEQAN_CALL_TEST(adapter_scanner_test);
+	SEQAN_CALL_TEST(adapter_table_test);
+	SEQAN_CALL_TEST(strip_adapter_batch_test);
+	SEQAN_CALL_TEST(score_overlap_test);
+	SEQAN_CALL_TEST(best_shift_bounded_test);
+	SEQAN_CALL_TEST(edit_distance_scan_test);
+	SEQAN_CALL_TEST(gapped_adapter_test);
 	SEQAN_CALL_TEST(strip_pair_test);
 }
 SEQAN_END_TESTSUITE
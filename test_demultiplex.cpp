@@ -454,13 +454,13 @@ SEQAN_DEFINE_TEST(demultiplex_Exact_Multiplex_test)
     auto expectedReads = reads;
     expectedReads[0].seq = "GTACGATCGTACGTACGATGCTACGATGCATGCTACGATGCTACG";
     expectedReads[1].seq = "AGTACGTACGTAGCTAGCTAGCATGCTAGCTAGCTAC";
-    expectedReads[3].seq = "TAGCTAGCTAGCTAGCTAGCTAGCTAGC";  // matched reads will be partitioned at the top
-    expectedReads[2].seq = "GGGG";
+    expectedReads[2].seq = "TAGCTAGCTAGCTAGCTAGCTAGCTAGC";  // the order of the reads is kept
+    expectedReads[3].seq = "GGGG";
 
     expectedReads[0].demuxResult = 3;
     expectedReads[1].demuxResult = 1;
-    expectedReads[3].demuxResult = 0;
-    expectedReads[2].demuxResult = 3;
+    expectedReads[2].demuxResult = 0;
+    expectedReads[3].demuxResult = 3;
 
     BarcodeMatcher BarcodeMatcher(barcodes);
 
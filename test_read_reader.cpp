@@ -0,0 +1,322 @@
+// ==========================================================================
+//                                SeqAn-Flexbar
+// ==========================================================================
+// Copyright (c) 2006-2015, Knut Reinert, FU Berlin
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Knut Reinert or the FU Berlin nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL KNUT REINERT OR THE FU BERLIN BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// ==========================================================================
+// Author: Benjamin Menkuec <benjamin@menkuec.de>
+// ==========================================================================
+
+#undef SEQAN_ENABLE_TESTING
+#define SEQAN_ENABLE_TESTING 1
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+#include <seqan/sequence.h>
+#include <seqan/seq_io.h>
+#include "read_reader.h"
+#include "read_writer.h"
+#include "checkpoint.h"
+
+// The second record has a quality line that begins with '@', the last line has no line break.
+const std::string testFastq = "@r1 1:N:0\nACGTN\n+\nIIII#\n@r2\nGG\n+\n@@\n@r3\nTTTA\n+\n@III\n@r4\nC\n+\nI";
+const std::string testFasta = ">s1 desc\nACGT\nTTGA\n>s2\nA\n>s3\n\n>s4\nGGCC\n";
+const std::string testInterleaved = "@p1/1\nAC\n+\n@I\n@p1/2\nGT\n+\nII\n@p2/1\nA\n+\n@\n@p2/2\nT\n+\nI\n";
+
+// Hands out the first split bytes with the first read, so that the chunker sees a buffer end at every offset.
+class SplitInputSource : public InputSource
+{
+    const std::string _data;
+    std::size_t _pos;
+    const std::size_t _split;
+
+public:
+    SplitInputSource(std::string data, const std::size_t split) : _data(std::move(data)), _pos(0), _split(split) {};
+    std::size_t read(char* buffer, const std::size_t len) override
+    {
+        const auto n = std::min(std::min(len, _pos == 0 ? _split : len), _data.size() - _pos);
+        std::copy(_data.begin() + _pos, _data.begin() + _pos + n, buffer);
+        _pos += n;
+        return n;
+    }
+};
+
+// Returns the concatenated blocks, every block has to begin with a record.
+std::string readAllBlocks(FastqChunker& chunker, const unsigned int records, const char recordStart, unsigned int& numRecords)
+{
+    std::string text;
+    RawBlock block;
+    numRecords = 0;
+    while (chunker.readBlock(block, records) != 0)
+    {
+        SEQAN_ASSERT(block.records <= records);
+        SEQAN_ASSERT_EQ(*block.first, recordStart);
+        text.append(block.first, block.last);
+        numRecords += block.records;
+    }
+    SEQAN_ASSERT(chunker.atEnd());
+    return text;
+}
+
+std::FILE* tmpFileWith(const std::string& data)
+{
+    std::FILE* file = std::tmpfile();
+    SEQAN_ASSERT(file != nullptr);
+    SEQAN_ASSERT_EQ(std::fwrite(data.data(), 1, data.size(), file), data.size());
+    std::rewind(file);
+    return file;
+}
+
+// Returns the offsets of the lines that begin with idStart.
+std::vector<std::uint64_t> lineStarts(const std::string& data, const std::string& idStart)
+{
+    std::vector<std::uint64_t> starts;
+    for (std::size_t pos = 0; pos < data.size(); pos = data.find('\n', pos) + 1)
+    {
+        if (data.compare(pos, idStart.size(), idStart) == 0)
+            starts.push_back(pos);
+        if (data.find('\n', pos) == std::string::npos)
+            break;
+    }
+    return starts;
+}
+
+SEQAN_DEFINE_TEST(chunker_boundary_test)
+{
+    for (const unsigned int records : {1u, 2u, 3u, 100u})
+    {
+        for (std::size_t split = 1; split <= testFastq.size(); ++split)
+        {
+            FastqChunker chunker(std::make_unique<SplitInputSource>(testFastq, split));
+            unsigned int numRecords = 0;
+            SEQAN_ASSERT_EQ(readAllBlocks(chunker, records, '@', numRecords), testFastq);
+            SEQAN_ASSERT_EQ(numRecords, 4u);
+            SEQAN_ASSERT_EQ(chunker.offset(), testFastq.size());
+        }
+        for (std::size_t split = 1; split <= testFasta.size(); ++split)
+        {
+            FastqChunker chunker(std::make_unique<SplitInputSource>(testFasta, split), RecordFormat::fasta);
+            unsigned int numRecords = 0;
+            SEQAN_ASSERT_EQ(readAllBlocks(chunker, records, '>', numRecords), testFasta);
+            SEQAN_ASSERT_EQ(numRecords, 4u);
+        }
+    }
+
+    // a record that is cut off is an error, not a shorter record
+    FastqChunker chunker(std::make_unique<SplitInputSource>(testFastq.substr(0, testFastq.size() - 3), 7));
+    RawBlock block;
+    bool thrown = false;
+    try
+    {
+        while (chunker.readBlock(block, 2) != 0);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    SEQAN_ASSERT(thrown);
+}
+
+SEQAN_DEFINE_TEST(parse_chunk_test)
+{
+    typedef seqan::String<seqan::Dna5Q> TSeq;
+    FastqChunker chunker(std::make_unique<SplitInputSource>(testFastq, 5));
+    RawChunk chunk;
+    SEQAN_ASSERT_EQ(chunker.readBlock(chunk.block1, 10), 4u);
+    std::vector<Read<TSeq>> reads;
+    parseChunk(reads, chunk);
+    SEQAN_ASSERT_EQ(reads.size(), 4u);
+    SEQAN_ASSERT_EQ(reads[0].id, "r1 1:N:0");
+    SEQAN_ASSERT_EQ(reads[0].seq, TSeq("ACGTN"));
+    SEQAN_ASSERT_EQ(seqan::getQualityValue(reads[1].seq[0]), '@' - '!');
+    SEQAN_ASSERT_EQ(reads[3].id, "r4");
+    SEQAN_ASSERT_EQ(reads[3].seq, TSeq("C"));
+
+    SEQAN_ASSERT(_sameMateName("p1/1", "p1/2"));
+    SEQAN_ASSERT(_sameMateName("p1 1:N:0", "p1 2:N:0"));
+    SEQAN_ASSERT_NOT(_sameMateName("p1/1", "p2/2"));
+}
+
+SEQAN_DEFINE_TEST(record_start_test)
+{
+    // every offset has to be moved to the next of the given record starts
+    const auto check = [](const std::string& data, const RecordFormat format, const bool pairs, const std::vector<std::uint64_t>& starts)
+    {
+        std::FILE* file = tmpFileWith(data);
+        const auto size = fileSize(file);
+        SEQAN_ASSERT_EQ(size, data.size());
+        for (std::uint64_t offset = 0; offset <= size; ++offset)
+        {
+            const auto next = std::lower_bound(starts.begin(), starts.end(), offset);
+            const std::uint64_t expected = next == starts.end() ? size : *next;
+            SEQAN_ASSERT_EQ(nextRecordStart(file, offset, size, format, pairs), expected);
+        }
+        std::fclose(file);
+    };
+    check(testFastq, RecordFormat::fastq, false, lineStarts(testFastq, "@r"));
+    check(testFasta, RecordFormat::fasta, false, lineStarts(testFasta, ">"));
+    check(testInterleaved, RecordFormat::fastq, false, lineStarts(testInterleaved, "@p"));
+    check(testInterleaved, RecordFormat::fastq, true, {0, lineStarts(testInterleaved, "@p2/1")[0]});
+
+    std::FILE* file = tmpFileWith(testInterleaved);
+    SEQAN_ASSERT_EQ(recordId(file, lineStarts(testInterleaved, "@p1/2")[0]), "p1/2");
+    std::fclose(file);
+}
+
+#if SEQAN_HAS_ZLIB
+SEQAN_DEFINE_TEST(bgzf_round_trip_test)
+{
+    typedef seqan::String<seqan::Dna5Q> TSeq;
+    const char* fileName = SEQAN_TEMP_FILENAME();
+    const unsigned int numRecords = 3000;   // several BGZF blocks
+    std::string expected;
+    {
+        ptc::TaskPool pool(2);
+        BgzfFileOut out(fileName, pool, 2, false);
+        for (unsigned int i = 0; i < numRecords; ++i)
+        {
+            TSeq seq;
+            std::string seqText, qual;
+            for (unsigned int k = 0; k < 50 + i % 51; ++k)
+            {
+                seqText.push_back("ACGTN"[(i + k) % 5]);
+                qual.push_back(static_cast<char>((i * k) % 41 + '!'));
+                seqan::appendValue(seq, seqan::Dna5Q(seqText.back()));
+                seqan::assignQualityValue(seq[k], static_cast<int>((i * k) % 41));
+            }
+            const std::string id = "read" + std::to_string(i);
+            out.writeRecord(id, seq);
+            expected += "@" + id + "\n" + seqText + "\n+\n" + qual + "\n";
+        }
+    }
+
+    // block by block
+    std::FILE* file = std::fopen(fileName, "rb");
+    SEQAN_ASSERT(file != nullptr);
+    SEQAN_ASSERT(isBgzf(file));
+    std::vector<unsigned char> block;
+    std::string text;
+    unsigned int numBlocks = 0;
+    std::size_t lastBlockSize = 1;
+    while (readBgzfBlock(file, block))
+    {
+        const auto data = inflateBgzfBlock(block);
+        SEQAN_ASSERT(data.size() <= bgzfMaxBlockData);
+        text.append(data.begin(), data.end());
+        lastBlockSize = data.size();
+        ++numBlocks;
+    }
+    SEQAN_ASSERT_EQ(text, expected);
+    SEQAN_ASSERT_GT(numBlocks, 3u);
+    SEQAN_ASSERT_EQ(lastBlockSize, 0u);     // the end of file marker
+    std::fclose(file);
+
+    // in parallel, as the reader does it
+    for (const unsigned int numThreads : {1u, 4u})
+    {
+        FastqChunker chunker(std::make_unique<BgzfInputSource>(std::fopen(fileName, "rb"), numThreads));
+        unsigned int records = 0;
+        SEQAN_ASSERT_EQ(readAllBlocks(chunker, 1000, '@', records), expected);
+        SEQAN_ASSERT_EQ(records, numRecords);
+    }
+
+    // and as a plain multi-member gzip file
+    FastqChunker chunker(std::make_unique<GzipInputSource>(std::make_unique<FileInputSource>(std::fopen(fileName, "rb"))));
+    unsigned int records = 0;
+    SEQAN_ASSERT_EQ(readAllBlocks(chunker, 1000, '@', records), expected);
+    SEQAN_ASSERT_EQ(records, numRecords);
+}
+#endif
+
+SEQAN_DEFINE_TEST(checkpoint_round_trip_test)
+{
+    const std::string fileName = SEQAN_TEMP_FILENAME();
+    Checkpoint checkpoint;
+    checkpoint.records = 123456789012ull;
+    checkpoint.inputOffset1 = 5000000000ull;
+    checkpoint.inputOffset2 = 5000000123ull;
+    checkpoint.outputs = {{"out.fq", 42}, {"dir with spaces/out 2.fq.gz", 4000000000ull}, {"", 0}};
+    auto& stats = checkpoint.stats;
+    stats = GeneralStats(3, 2);
+    stats.removedN = 1;
+    stats.removedDemultiplex = 2;
+    stats.removedQuality = 3;
+    stats.uncalledBases = 4;
+    stats.removedShort = 5;
+    stats.readCount = 6;
+    stats.ioTime = 1.5;
+    stats.matchedBarcodeReads = {7, 8, 9, 10};
+    stats.adapterTrimmingStats.overlapSum = 11;
+    stats.adapterTrimmingStats.minOverlap = 12;
+    stats.adapterTrimmingStats.maxOverlap = 13;
+    stats.adapterTrimmingStats.numRemoved = {14, 15};
+    stats.adapterTrimmingStats.removedLength = {{16, 17}, {}, {18}};
+    saveCheckpoint(fileName, checkpoint);
+
+    Checkpoint loaded;
+    SEQAN_ASSERT(loadCheckpoint(fileName, loaded));
+    SEQAN_ASSERT_EQ(loaded.records, checkpoint.records);
+    SEQAN_ASSERT_EQ(loaded.inputOffset1, checkpoint.inputOffset1);
+    SEQAN_ASSERT_EQ(loaded.inputOffset2, checkpoint.inputOffset2);
+    SEQAN_ASSERT(loaded.outputs == checkpoint.outputs);
+    const auto& loadedStats = loaded.stats;
+    SEQAN_ASSERT_EQ(loadedStats.removedN, 1u);
+    SEQAN_ASSERT_EQ(loadedStats.removedDemultiplex, 2u);
+    SEQAN_ASSERT_EQ(loadedStats.removedQuality, 3u);
+    SEQAN_ASSERT_EQ(loadedStats.uncalledBases, 4u);
+    SEQAN_ASSERT_EQ(loadedStats.removedShort, 5u);
+    SEQAN_ASSERT_EQ(loadedStats.readCount, 6u);
+    SEQAN_ASSERT_EQ(loadedStats.ioTime, 1.5);
+    SEQAN_ASSERT(loadedStats.matchedBarcodeReads == stats.matchedBarcodeReads);
+    SEQAN_ASSERT_EQ(loadedStats.adapterTrimmingStats.overlapSum, 11u);
+    SEQAN_ASSERT_EQ(loadedStats.adapterTrimmingStats.minOverlap, 12u);
+    SEQAN_ASSERT_EQ(loadedStats.adapterTrimmingStats.maxOverlap, 13u);
+    SEQAN_ASSERT(loadedStats.adapterTrimmingStats.numRemoved == stats.adapterTrimmingStats.numRemoved);
+    SEQAN_ASSERT(loadedStats.adapterTrimmingStats.removedLength == stats.adapterTrimmingStats.removedLength);
+
+    // a file that is not a checkpoint
+    std::FILE* file = std::fopen(fileName.c_str(), "w");
+    std::fputs("flexcat checkpoint 2\n", file);
+    std::fclose(file);
+    SEQAN_ASSERT_NOT(loadCheckpoint(fileName, loaded));
+}
+
+SEQAN_BEGIN_TESTSUITE(test_my_app_funcs)
+{
+    SEQAN_CALL_TEST(chunker_boundary_test);
+    SEQAN_CALL_TEST(parse_chunk_test);
+    SEQAN_CALL_TEST(record_start_test);
+#if SEQAN_HAS_ZLIB
+    SEQAN_CALL_TEST(bgzf_round_trip_test);
+#endif
+    SEQAN_CALL_TEST(checkpoint_round_trip_test);
+}
+SEQAN_END_TESTSUITE